@@ -0,0 +1,426 @@
+#include <getopt.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lame.h"
+
+#include "io/memory_source.hh"
+#include "mp3/frame_header.hh"
+#include "wav/encoder.hh"
+#include "wav/header.hh"
+#include "wav/kernel_table.hh"
+#include "wav/kernels.hh"
+
+#include "harness.hh"
+#include "wav_synth.hh"
+
+// sample rate of the synthetic inputs.
+const unsigned int kSampleRate = 44100;
+
+// LameFlags closes an encoder made by InitLame() when it goes away.
+typedef std::unique_ptr<lame_global_flags, decltype(&lame_close)> LameFlags;
+
+// @desc - creates an encoder for a file with the settings of the converter.
+// @param header - header of the file.
+// @return LameFlags - empty on error.
+static LameFlags MakeLame(const WavHeader& header) {
+  return LameFlags(InitLame(header, false), lame_close);
+}
+
+// @desc - describes raw samples of a synthetic format, so they can be read
+//         as a wav file without a header.
+// @param format - format of the samples.
+// @param number_of_channels - number of channels.
+// @return WavHeader::Format
+static WavHeader::Format MakeRawFormat(const SampleFormat& format,
+                                       unsigned int number_of_channels) {
+  WavHeader::Format raw = {};
+  raw.audio_format = format.audio_format;
+  raw.number_of_channels = number_of_channels;
+  raw.sample_rate = kSampleRate;
+  raw.bits_per_sample = (format.bits + 7) / 8 * 8;
+  raw.valid_bits_per_sample = format.bits;
+  return raw;
+}
+
+// @desc - benchmarks the sample kernels of every instruction set the cpu
+//         supports, on random input.
+static void RunKernelBenchmarks(const BenchmarkSettings& settings) {
+  const size_t n = 1 << 16;
+  Random random;
+  std::vector<uint8_t> input(n * 4);
+  for (auto& byte : input) {
+    byte = random.Next();
+  }
+  std::vector<int32_t> output(n);
+  auto out = output.data();
+  // 5.1 frames are mixed down to stereo with the standard matrix. float
+  // samples are kept in range, random bytes would make denormals and nans.
+  const unsigned int kSurroundChannels = 6;
+  const size_t surround_frames = n / kSurroundChannels;
+  auto matrix = MakeDownmixMatrix(0, kSurroundChannels, 2);
+  std::vector<float> input_f32(n);
+  for (auto& sample : input_f32) {
+    sample = random.NextUnit() - 0.5;
+  }
+
+  for (auto name : {"scalar", "ssse3", "avx2", "avx512"}) {
+    auto kernels = FindSampleKernels(name);
+    if (!kernels) {
+      continue;
+    }
+    auto prefix = std::string("kernel/") + name + "/";
+    RunBenchmark(settings, {prefix + "u8", n, "smp", n, 0, [&] {
+      kernels->convert_u8(input.data(), (int16_t*)out, n);
+      DoNotOptimize(out);
+    }});
+    RunBenchmark(settings, {prefix + "s16", n, "smp", n * 2, 0, [&] {
+      kernels->convert_s16[16](input.data(), (int16_t*)out, n);
+      DoNotOptimize(out);
+    }});
+    RunBenchmark(settings, {prefix + "s16/12", n, "smp", n * 2, 0, [&] {
+      kernels->convert_s16[12](input.data(), (int16_t*)out, n);
+      DoNotOptimize(out);
+    }});
+    RunBenchmark(settings, {prefix + "s24", n, "smp", n * 3, 0, [&] {
+      kernels->convert_s24[24](input.data(), out, n);
+      DoNotOptimize(out);
+    }});
+    RunBenchmark(settings, {prefix + "s24/20", n, "smp", n * 3, 0, [&] {
+      kernels->convert_s24[20](input.data(), out, n);
+      DoNotOptimize(out);
+    }});
+    RunBenchmark(settings, {prefix + "s32", n, "smp", n * 4, 0, [&] {
+      kernels->convert_s32[32](input.data(), out, n);
+      DoNotOptimize(out);
+    }});
+    RunBenchmark(settings, {prefix + "f32", n, "smp", n * 4, 0, [&] {
+      kernels->convert_f32(input.data(), (float*)out, n);
+      DoNotOptimize(out);
+    }});
+    RunBenchmark(settings, {prefix + "alaw", n, "smp", n, 0, [&] {
+      kernels->convert_alaw(input.data(), (int16_t*)out, n);
+      DoNotOptimize(out);
+    }});
+    RunBenchmark(settings, {prefix + "mulaw", n, "smp", n, 0, [&] {
+      kernels->convert_mulaw(input.data(), (int16_t*)out, n);
+      DoNotOptimize(out);
+    }});
+    auto surround_samples = surround_frames * kSurroundChannels;
+    RunBenchmark(settings, {prefix + "downmix/s16", surround_samples, "smp",
+                            surround_samples * 2, 0, [&] {
+      kernels->downmix_s16((const int16_t*)input.data(), (float*)out,
+                           surround_frames, matrix);
+      DoNotOptimize(out);
+    }});
+    RunBenchmark(settings, {prefix + "downmix/s32", surround_samples, "smp",
+                            surround_samples * 4, 0, [&] {
+      kernels->downmix_s32((const int32_t*)input.data(), (float*)out,
+                           surround_frames, matrix);
+      DoNotOptimize(out);
+    }});
+    RunBenchmark(settings, {prefix + "downmix/f32", surround_samples, "smp",
+                            surround_samples * 4, 0, [&] {
+      kernels->downmix_f32(input_f32.data(), (float*)out, surround_frames,
+                           matrix);
+      DoNotOptimize(out);
+    }});
+  }
+}
+
+// @desc - benchmarks the pcm kernels the parser resolves for every format,
+//         one block of the converter per call.
+static void RunPCMKernelBenchmarks(const BenchmarkSettings& settings) {
+  for (unsigned int channels = 1; channels <= 2; ++channels) {
+    Random random;
+    auto signal = GenerateSignal(0, kFramesPerBlock, channels, kSampleRate,
+                                 random);
+    // large enough for samples of every type.
+    std::vector<double> output(signal.size());
+    auto out = output.data();
+    for (size_t i = 0; i < kNumberOfSampleFormats; ++i) {
+      auto& format = kSampleFormats[i];
+      auto kernel = ResolvePCMKernel(format.audio_format, format.bits,
+                                     format.bits, channels);
+      if (!kernel.IsSupported()) {
+        continue;
+      }
+      auto data = EncodeSamples(format, signal);
+      auto name = std::string("pcm/") + format.name +
+                  (channels == 1 ? "/mono" : "/stereo");
+      RunBenchmark(settings, {name, signal.size(), "smp", data.size(),
+                              (double)kFramesPerBlock / kSampleRate, [&] {
+        kernel.Convert(data.data(), kFramesPerBlock, out);
+        DoNotOptimize(out);
+      }});
+    }
+  }
+}
+
+// @desc - benchmarks parsing the chunks of a file, and reading all its
+//         samples through WavHeader for every format.
+static void RunParseBenchmarks(const BenchmarkSettings& settings) {
+  Random random;
+  auto signal = GenerateSignal(0, kSampleRate, 2, kSampleRate, random);
+  auto& int16 = *FindSampleFormat("int16");
+  auto wav = MakeWav(int16, WavLayout::kExtraChunks, 2, kSampleRate,
+                     EncodeSamples(int16, signal));
+  RunBenchmark(settings, {"parse/chunks", 0, "", 0, 0, [&] {
+    MemorySource source(wav.data(), wav.size());
+    WavHeader header(source);
+    DoNotOptimize(&header.GetFormat());
+  }});
+
+  for (size_t i = 0; i < kNumberOfSampleFormats; ++i) {
+    auto& format = kSampleFormats[i];
+    auto data = EncodeSamples(format, signal);
+    auto wav = MakeWav(format, WavLayout::kPlain, 2, kSampleRate, data);
+    RunBenchmark(settings, {std::string("read/") + format.name + "/stereo",
+                            signal.size(), "smp", data.size(), 1, [&, wav] {
+      MemorySource source(wav.data(), wav.size());
+      WavHeader header(source);
+      const void* samples;
+      while (header.FetchPCMFrames(kFramesPerBlock, &samples) > 0) {
+        DoNotOptimize(samples);
+      }
+    }});
+  }
+
+  // 5.1 files are converted and mixed down to stereo in one pass.
+  auto surround_signal = GenerateSignal(0, kSampleRate, 6, kSampleRate,
+                                        random);
+  for (auto name : {"int16", "int24", "float32"}) {
+    auto& format = *FindSampleFormat(name);
+    auto data = EncodeSamples(format, surround_signal);
+    auto wav = MakeWav(format, WavLayout::kExtensible, 6, kSampleRate, data);
+    RunBenchmark(settings, {std::string("read/") + name + "/5.1",
+                            surround_signal.size(), "smp", data.size(), 1,
+                            [&, wav] {
+      MemorySource source(wav.data(), wav.size());
+      WavHeader header(source);
+      const void* samples;
+      while (header.FetchPCMFrames(kFramesPerBlock, &samples) > 0) {
+        DoNotOptimize(samples);
+      }
+    }});
+  }
+}
+
+// @desc - benchmarks setting up an encoder, encoding every sample type lame
+//         takes, and walking the frames of its output.
+static void RunLameBenchmarks(const BenchmarkSettings& settings) {
+  Random random;
+  auto& int16 = *FindSampleFormat("int16");
+  auto one_second = EncodeSamples(int16, GenerateSignal(0, kSampleRate, 2,
+                                                        kSampleRate, random));
+  MemorySource one_second_source(one_second.data(), one_second.size());
+  WavHeader one_second_header(one_second_source, MakeRawFormat(int16, 2));
+  RunBenchmark(settings, {"lame/init", 0, "", 0, 0, [&] {
+    auto flags = MakeLame(one_second_header);
+    DoNotOptimize(flags.get());
+  }});
+
+  // the formats lame takes as they are, named after their sample types.
+  const std::pair<const char*, const char*> kLameFormats[] = {
+    {"int16", "int16"}, {"int32", "int32"}, {"float32", "float"},
+    {"float64", "double"},
+  };
+  PooledBuffer mp3_buff(kMP3BufferSize);
+  for (unsigned int channels = 1; channels <= 2; ++channels) {
+    Random random;
+    auto signal = GenerateSignal(0, kSampleRate, channels, kSampleRate,
+                                 random);
+    for (auto& lame_format : kLameFormats) {
+      auto& format = *FindSampleFormat(lame_format.first);
+      auto samples = EncodeSamples(format, signal);
+      MemorySource source(samples.data(), samples.size());
+      WavHeader header(source, MakeRawFormat(format, channels));
+      // one encoder runs through all calls, as it would through a long file.
+      auto flags = MakeLame(header);
+      auto encode = GetEncodeFunction(header);
+      auto name = std::string("lame/encode/") + lame_format.second +
+                  (channels == 1 ? "/mono" : "/stereo");
+      RunBenchmark(settings, {name, signal.size(), "smp", 0, 1, [&] {
+        auto block_size = kFramesPerBlock * header.GetFormat().block_align;
+        for (size_t offset = 0; offset < samples.size();
+             offset += block_size) {
+          auto frames = std::min(block_size, samples.size() - offset) /
+                        header.GetFormat().block_align;
+          encode(flags.get(), &samples[offset], frames, mp3_buff.GetData());
+        }
+      }});
+    }
+  }
+
+  // ten seconds of mp3 to walk through by frame headers.
+  auto samples = EncodeSamples(int16, GenerateSignal(0, 10 * kSampleRate, 2,
+                                                     kSampleRate, random));
+  MemorySource source(samples.data(), samples.size());
+  WavHeader header(source, MakeRawFormat(int16, 2));
+  auto flags = MakeLame(header);
+  auto encode = GetEncodeFunction(header);
+  std::vector<uint8_t> mp3;
+  const void* pcm;
+  size_t frames;
+  while ((frames = header.FetchPCMFrames(kFramesPerBlock, &pcm)) > 0) {
+    auto bytes = encode(flags.get(), pcm, frames, mp3_buff.GetData());
+    mp3.insert(mp3.end(), mp3_buff.GetData(), mp3_buff.GetData() + bytes);
+  }
+  auto bytes = lame_encode_flush(flags.get(), mp3_buff.GetData(),
+                                 kMP3BufferSize);
+  mp3.insert(mp3.end(), mp3_buff.GetData(), mp3_buff.GetData() + bytes);
+  size_t number_of_frames = 0;
+  size_t frame_size;
+  for (size_t offset = 0; offset + kMP3FrameHeaderSize <= mp3.size() &&
+       (frame_size = GetMP3FrameSize(&mp3[offset])) != 0;
+       offset += frame_size) {
+    ++number_of_frames;
+  }
+  RunBenchmark(settings, {"mp3/frame_headers", number_of_frames, "frame",
+                          mp3.size(), 10, [&] {
+    size_t offset = 0;
+    while (offset + kMP3FrameHeaderSize <= mp3.size()) {
+      auto frame_size = GetMP3FrameSize(&mp3[offset]);
+      if (frame_size == 0) {
+        break;
+      }
+      offset += frame_size;
+    }
+    DoNotOptimize(&offset);
+  }});
+}
+
+// @desc - benchmarks converting the wav files of a directory from memory:
+//         parsing, reading samples and encoding them with a new encoder, as
+//         the converter does without the file system.
+// @param directory - directory of the files, test_data of the repository.
+static void RunFileBenchmarks(const BenchmarkSettings& settings,
+                              const std::filesystem::path& directory) {
+  std::error_code error;
+  std::vector<std::filesystem::path> paths;
+  for (auto& entry : std::filesystem::directory_iterator(directory, error)) {
+    if (entry.path().extension() == ".wav") {
+      paths.push_back(entry.path());
+    }
+  }
+  std::sort(paths.begin(), paths.end());
+
+  PooledBuffer mp3_buff(kMP3BufferSize);
+  for (auto& path : paths) {
+    auto name = "file/" + path.stem().string();
+    if (name.find(settings.filter) == std::string::npos) {
+      continue;
+    }
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> wav((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+    MemorySource source(wav.data(), wav.size());
+    WavHeader header(source);
+    auto& format = header.GetFormat();
+    if (!header.IsValidWav() || !header.GetPCMKernel().IsSupported()) {
+      printf("%-36s unsupported format\n", name.c_str());
+      continue;
+    }
+
+    auto number_of_frames = header.GetNumberOfSamples();
+    RunBenchmark(settings, {name, number_of_frames * format.number_of_channels,
+                            "smp", header.GetDataSize(),
+                            (double)number_of_frames / format.sample_rate, [&] {
+      MemorySource source(wav.data(), wav.size());
+      WavHeader header(source);
+      auto flags = MakeLame(header);
+      auto encode = GetEncodeFunction(header);
+      const void* samples;
+      size_t frames;
+      while ((frames = header.FetchPCMFrames(kFramesPerBlock, &samples)) > 0) {
+        encode(flags.get(), samples, frames, mp3_buff.GetData());
+      }
+      lame_encode_flush(flags.get(), mp3_buff.GetData(), kMP3BufferSize);
+    }});
+  }
+}
+
+void PrintUsage() {
+  printf("USAGE: washmywaves_bench [options] [test_data_directory]\n");
+  printf("  options:\n");
+  printf("    -f, --filter TEXT  only run benchmarks whose name contains\n");
+  printf("                  TEXT, for example \"kernel/avx2\" or \"lame\".\n");
+  printf("    -r, --repetitions N  number of timed repetitions, 15 by\n");
+  printf("                  default. the median is reported.\n");
+  printf("    -t, --min-time MS  minimum time of each repetition, 20ms by\n");
+  printf("                  default.\n");
+  printf("    -w, --warm-up MS  untimed run before the repetitions, 200ms\n");
+  printf("                  by default.\n");
+  printf("  the wav files of test_data_directory, ./test_data by default,\n");
+  printf("  are converted from memory in addition to synthetic inputs.\n");
+}
+
+int main(int argc, char* argv[]) {
+  BenchmarkSettings settings;
+
+  const struct option long_options[] = {
+    {"filter", required_argument, nullptr, 'f'},
+    {"repetitions", required_argument, nullptr, 'r'},
+    {"min-time", required_argument, nullptr, 't'},
+    {"warm-up", required_argument, nullptr, 'w'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "f:r:t:w:h", long_options,
+                               nullptr)) != -1) {
+    switch (option) {
+      case 'f':
+        settings.filter = optarg;
+        break;
+      case 'r':
+      case 't':
+      case 'w': {
+        char* end = nullptr;
+        auto value = strtol(optarg, &end, 10);
+        if (*end != '\0' || value < (option == 'w' ? 0 : 1)) {
+          printf("invalid value: %s\n", optarg);
+          return 1;
+        }
+        if (option == 'r') {
+          settings.repetitions = value;
+        } else if (option == 't') {
+          settings.min_repetition_seconds = value / 1000.0;
+        } else {
+          settings.warm_up_seconds = value / 1000.0;
+        }
+        break;
+      }
+      case 'h':
+        PrintUsage();
+        return 0;
+      default:
+        PrintUsage();
+        return 1;
+    }
+  }
+  if (argc - optind > 1) {
+    PrintUsage();
+    return 1;
+  }
+  std::filesystem::path test_data = optind < argc ? argv[optind] : "test_data";
+
+  printf("sample kernels: %s\n", GetSampleKernels().name);
+  PrintBenchmarkHeader();
+  RunKernelBenchmarks(settings);
+  RunPCMKernelBenchmarks(settings);
+  RunParseBenchmarks(settings);
+  RunLameBenchmarks(settings);
+  RunFileBenchmarks(settings, test_data);
+  return 0;
+}
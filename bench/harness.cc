@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "harness.hh"
+
+typedef std::chrono::steady_clock Clock;
+
+// @desc - calls a function a number of times and measures it.
+// @param run - the function.
+// @param count - number of calls.
+// @return double - seconds taken by all calls.
+static double TimeCalls(const std::function<void()>& run, size_t count) {
+  auto start = Clock::now();
+  for (size_t i = 0; i < count; ++i) {
+    run();
+  }
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void PrintBenchmarkHeader() {
+  printf("%-36s %14s %10s %10s %8s\n", "benchmark", "time", "MB/s",
+         "realtime", "spread");
+}
+
+void RunBenchmark(const BenchmarkSettings& settings,
+                  const Benchmark& benchmark) {
+  if (benchmark.name.find(settings.filter) == std::string::npos) {
+    return;
+  }
+
+  // the warm-up also estimates the time of a call, which decides the number
+  // of calls in each repetition.
+  size_t calls = 0;
+  double elapsed = 0;
+  do {
+    elapsed += TimeCalls(benchmark.run, 1);
+    ++calls;
+  } while (elapsed < settings.warm_up_seconds);
+  auto calls_per_repetition = std::max<size_t>(
+      1, settings.min_repetition_seconds / (elapsed / calls));
+
+  std::vector<double> times;
+  for (unsigned int i = 0; i < std::max(1u, settings.repetitions); ++i) {
+    times.push_back(TimeCalls(benchmark.run, calls_per_repetition) /
+                    calls_per_repetition);
+  }
+  std::sort(times.begin(), times.end());
+  auto median = times[times.size() / 2];
+  // half the distance between the fastest and the slowest repetition of the
+  // middle half, relative to the median. a wide spread means the machine
+  // was busy and the result should not be trusted.
+  auto spread = (times[times.size() * 3 / 4] - times[times.size() / 4]) / 2 /
+                median;
+
+  char time[32];
+  if (benchmark.items) {
+    snprintf(time, sizeof(time), "%.3f ns/%s", median * 1e9 / benchmark.items,
+             benchmark.unit);
+  } else {
+    snprintf(time, sizeof(time), "%.0f ns", median * 1e9);
+  }
+  char rate[32] = "-";
+  if (benchmark.bytes) {
+    snprintf(rate, sizeof(rate), "%.1f", benchmark.bytes / median / 1e6);
+  }
+  char realtime[32] = "-";
+  if (benchmark.audio_seconds > 0) {
+    snprintf(realtime, sizeof(realtime), "%.1fx",
+             benchmark.audio_seconds / median);
+  }
+  printf("%-36s %14s %10s %10s %7.1f%%\n", benchmark.name.c_str(), time, rate,
+         realtime, spread * 100);
+  fflush(stdout);
+}
@@ -0,0 +1,56 @@
+#ifndef WASHMYWAVES_BENCH_HARNESS_H__
+#define WASHMYWAVES_BENCH_HARNESS_H__
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// BenchmarkSettings control how long and how often every benchmark runs.
+struct BenchmarkSettings {
+  // only benchmarks whose name contains this string are run.
+  std::string filter;
+  // the benchmark is run untimed for at least this long first, so caches,
+  // branch predictors, the buffer pool and the cpu clock are warmed up.
+  double warm_up_seconds = 0.2;
+  // number of timed repetitions, the reported time is their median.
+  unsigned int repetitions = 15;
+  // each repetition calls the benchmark enough times to take at least this
+  // long, so the timer resolution does not matter.
+  double min_repetition_seconds = 0.02;
+};
+
+// Benchmark is one measured operation. the amounts describe what a single
+// call of run processes, they are used to turn the time of a call into
+// rates.
+struct Benchmark {
+  std::string name;
+  // number of items one call processes, usually samples of all channels.
+  // 0 reports the time per call instead of per item.
+  size_t items = 0;
+  // short name of the items, printed after the time per item.
+  const char* unit = "smp";
+  // number of input bytes one call processes, 0 if not meaningful.
+  size_t bytes = 0;
+  // duration of the audio one call processes, 0 if not meaningful.
+  double audio_seconds = 0;
+  std::function<void()> run;
+};
+
+// @desc - prints the header of the result table.
+void PrintBenchmarkHeader();
+
+// @desc - warms up, measures and prints one benchmark, unless it is filtered
+//         out. every repetition is timed separately and the median is
+//         reported together with the spread of the repetitions around it.
+// @param settings - how to measure.
+// @param benchmark - what to measure.
+void RunBenchmark(const BenchmarkSettings& settings,
+                  const Benchmark& benchmark);
+
+// @desc - keeps the compiler from optimizing away the computation of a value
+//         that is otherwise unused.
+// @param data - pointer to the result.
+inline void DoNotOptimize(const void* data) {
+  asm volatile("" : : "r"(data) : "memory");
+}
+
+#endif // WASHMYWAVES_BENCH_HARNESS_H__
@@ -0,0 +1,51 @@
+#include <algorithm>
+
+#include "io/callback_source.hh"
+
+CallbackSource::CallbackSource(const ReadCallback& read) : read_(read) {
+}
+
+size_t CallbackSource::Read(void* buffer, size_t size) {
+  // the callback may return less than asked for before the end, it is
+  // called until size bytes are read or it has nothing more.
+  size_t bytes_read = 0;
+  while (bytes_read < size && !ended_) {
+    auto bytes = read_((char*)buffer + bytes_read, size - bytes_read);
+    if (bytes == 0) {
+      ended_ = true;
+    }
+    bytes_read += std::min(bytes, size - bytes_read);
+  }
+  position_ += bytes_read;
+  return bytes_read;
+}
+
+size_t CallbackSource::Fetch(size_t size, const uint8_t** data) {
+  buffer_.Reserve(size);
+  *data = buffer_.GetData();
+  return Read(buffer_.GetData(), size);
+}
+
+bool CallbackSource::Seek(uint64_t offset) {
+  // the input can only move forward, by reading and dropping bytes.
+  if (offset < position_) {
+    return false;
+  }
+  char skipped[4096];
+  while (position_ < offset) {
+    auto size = (size_t)std::min<uint64_t>(sizeof(skipped),
+                                           offset - position_);
+    if (Read(skipped, size) != size) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t CallbackSource::Tell() const {
+  return position_;
+}
+
+uint64_t CallbackSource::GetSize() const {
+  return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef WASHMYWAVES_IO_CALLBACK_SOURCE_H__
+#define WASHMYWAVES_IO_CALLBACK_SOURCE_H__
+#include <functional>
+
+#include "io/source.hh"
+#include "utils/buffer_pool.hh"
+
+// CallbackSource reads from a function of the caller, like a network upload
+// that arrives in pieces. Fetch() copies the bytes into a pooled buffer. the
+// input can only be read forward, its size is unknown.
+class CallbackSource : public Source {
+public:
+  // @desc - reads the next bytes of input.
+  // @param buffer - destination of at most size bytes.
+  // @param size - number of bytes wanted.
+  // @return size_t - number of bytes read, it may be less than size. 0 at
+  //         the end of input.
+  typedef std::function<size_t(void* buffer, size_t size)> ReadCallback;
+
+  // @param read - the function, it must outlive the source.
+  explicit CallbackSource(const ReadCallback& read);
+
+  size_t Read(void* buffer, size_t size) override;
+  size_t Fetch(size_t size, const uint8_t** data) override;
+  bool Seek(uint64_t offset) override;
+  uint64_t Tell() const override;
+  uint64_t GetSize() const override;
+
+private:
+  const ReadCallback& read_;
+  PooledBuffer buffer_;
+  uint64_t position_ = 0;
+  bool ended_ = false;
+};
+
+#endif // WASHMYWAVES_IO_CALLBACK_SOURCE_H__
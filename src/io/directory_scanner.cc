@@ -0,0 +1,295 @@
+#ifdef __linux__
+#include <dirent.h>     // for DT_* types.
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "io/directory_scanner.hh"
+#include "utils/metrics.hh"
+#include "utils/shard.hh"
+
+// a wav file found in a directory, before it is queued.
+struct FoundFile {
+  std::filesystem::path path;
+  uint64_t size;
+};
+
+bool HasWavExtension(const char* name, size_t length) {
+  // file names are compared byte by byte as ascii, which leaves utf-8 names
+  // untouched.
+  static const char kExtension[] = ".wav";
+  const size_t kExtensionLength = sizeof(kExtension) - 1;
+  if (length <= kExtensionLength) {
+    return false;
+  }
+  name += length - kExtensionLength;
+  for (size_t i = 0; i < kExtensionLength; i++) {
+    char c = name[i];
+    if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+    if (c != kExtension[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// files smaller than this are queued in batches. a clip of a few seconds
+// takes less time to encode than to schedule and set up.
+const uint64_t kSmallFileSize = 1 << 20;
+// maximum total size and number of files of a batch.
+const uint64_t kBatchSize = 8 << 20;
+const size_t kMaxBatchFiles = 64;
+
+// @desc - queues the files of a directory, largest first, so a huge file
+//         starts early instead of being the tail of the batch. small files,
+//         which come last, are queued a batch per task.
+static void QueueFiles(std::vector<FoundFile>& files, WorkerPool& pool,
+                       const std::shared_ptr<WavFileHandler>& handler) {
+  std::stable_sort(files.begin(), files.end(),
+      [](const FoundFile& a, const FoundFile& b) { return a.size > b.size; });
+  GetMetrics().files_found.Add(files.size());
+  size_t i = 0;
+  for (; i < files.size() && files[i].size >= kSmallFileSize; i++) {
+    pool.Submit([handler, path = std::move(files[i].path)] {
+      (*handler)(path);
+    });
+  }
+
+  while (i < files.size()) {
+    std::vector<std::filesystem::path> batch;
+    uint64_t batch_size = 0;
+    for (; i < files.size() && batch.size() < kMaxBatchFiles &&
+           batch_size < kBatchSize; i++) {
+      batch_size += files[i].size;
+      batch.push_back(std::move(files[i].path));
+    }
+    pool.Submit([handler, batch = std::move(batch)] {
+      for (const auto& path : batch) {
+        (*handler)(path);
+      }
+    });
+  }
+}
+
+static void ScanDirectory(const std::filesystem::path& directory,
+                          WorkerPool& pool,
+                          const std::shared_ptr<WavFileHandler>& handler,
+                          const Shard& shard, size_t root_size);
+
+// @desc - queues the scan of a subdirectory in front of the other tasks.
+// @param root_size - size of the part of directory that names the root of
+//        the tree, see IsInShard().
+static void QueueDirectory(std::filesystem::path directory, WorkerPool& pool,
+                           const std::shared_ptr<WavFileHandler>& handler,
+                           const Shard& shard, size_t root_size) {
+  pool.Submit([directory = std::move(directory), &pool, handler, shard,
+               root_size] {
+    ScanDirectory(directory, pool, handler, shard, root_size);
+  }, true);
+}
+
+#ifdef __linux__
+// entry of the buffer filled by getdents64, as defined in getdents(2).
+struct LinuxDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+// size of the buffer that directory entries are read in. one call returns
+// hundreds of entries.
+const size_t kDirentBufferSize = 64 * 1024;
+
+static void ScanDirectory(const std::filesystem::path& directory,
+                          WorkerPool& pool,
+                          const std::shared_ptr<WavFileHandler>& handler,
+                          const Shard& shard, size_t root_size) {
+  int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    printf("[ERROR] %s: cannot open directory.\n", directory.c_str());
+    return;
+  }
+
+  // entries are read in large batches, and their types come with them, so
+  // only wav files and entries of unknown type cost a stat.
+  std::unique_ptr<char[]> buffer(new char[kDirentBufferSize]);
+  std::vector<FoundFile> files;
+  long bytes_read;
+  while ((bytes_read = syscall(SYS_getdents64, fd, buffer.get(),
+                               kDirentBufferSize)) > 0) {
+    for (long offset = 0; offset < bytes_read;) {
+      auto entry = (const LinuxDirent64*)(buffer.get() + offset);
+      offset += entry->d_reclen;
+      const char* name = entry->d_name;
+      if (name[0] == '.' &&
+          (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+        continue;
+      }
+
+      auto type = entry->d_type;
+      auto length = strlen(name);
+      bool is_wav = HasWavExtension(name, length);
+      if (type != DT_DIR && type != DT_UNKNOWN && !is_wav) {
+        continue;
+      }
+      // files of other shards are not even stat'ed.
+      bool in_shard = type == DT_DIR ||
+                      IsInShard(directory / name, root_size, shard);
+      if (!in_shard && type != DT_UNKNOWN) {
+        continue;
+      }
+
+      struct stat entry_stat;
+      if (type == DT_UNKNOWN) {
+        // the entry itself is stat'ed, so links to directories are told
+        // apart from directories and are not scanned.
+        if (fstatat(fd, name, &entry_stat, AT_SYMLINK_NOFOLLOW) != 0) {
+          continue;
+        }
+        if (S_ISDIR(entry_stat.st_mode)) {
+          type = DT_DIR;
+        } else if (S_ISLNK(entry_stat.st_mode)) {
+          type = DT_LNK;
+        }
+      }
+
+      if (type == DT_DIR) {
+        QueueDirectory(directory / name, pool, handler, shard, root_size);
+        continue;
+      }
+      if (!is_wav || !in_shard) {
+        continue;
+      }
+      // links are followed to their targets, like the files they point to
+      // would be opened. only regular files are queued, not a fifo or a
+      // link to a directory that is named like a wav file.
+      if (type != DT_UNKNOWN && fstatat(fd, name, &entry_stat, 0) != 0) {
+        continue;
+      }
+      if (S_ISREG(entry_stat.st_mode)) {
+        files.push_back({directory / name, (uint64_t)entry_stat.st_size});
+      }
+    }
+  }
+  if (bytes_read < 0) {
+    printf("[ERROR] %s: cannot read directory.\n", directory.c_str());
+  }
+  close(fd);
+
+  QueueFiles(files, pool, handler);
+}
+#else
+static void ScanDirectory(const std::filesystem::path& directory,
+                          WorkerPool& pool,
+                          const std::shared_ptr<WavFileHandler>& handler,
+                          const Shard& shard, size_t root_size) {
+  // directory_iterator, introduced in C++17, is platform independant.
+  std::error_code error;
+  std::filesystem::directory_iterator iterator(directory, error);
+  if (error) {
+    printf("[ERROR] %s: cannot open directory.\n", directory.c_str());
+    return;
+  }
+
+  std::vector<FoundFile> files;
+  for (const auto& entry : iterator) {
+    if (entry.is_directory(error) && !entry.is_symlink(error)) {
+      QueueDirectory(entry.path(), pool, handler, shard, root_size);
+      continue;
+    }
+    auto name = entry.path().filename().string();
+    // only regular files are queued, links are followed to their targets.
+    if (HasWavExtension(name.c_str(), name.size()) &&
+        IsInShard(entry.path(), root_size, shard) &&
+        entry.is_regular_file(error)) {
+      auto size = entry.file_size(error);
+      files.push_back({entry.path(), error ? 0 : size});
+    }
+  }
+
+  QueueFiles(files, pool, handler);
+}
+#endif
+
+void ScanWavFiles(const std::filesystem::path& directory, WorkerPool& pool,
+                  WavFileHandler handler, const Shard& shard,
+                  const std::filesystem::path& root) {
+  // the handler is shared by every task instead of being copied into each.
+  auto shared_handler = std::make_shared<WavFileHandler>(std::move(handler));
+  QueueDirectory(directory, pool, shared_handler, shard,
+                 GetShardRootSize(root.empty() ? directory : root));
+}
+
+QueuedPaths::QueuedPaths() {
+  std::error_code error;
+  current_directory_ = std::filesystem::current_path(error);
+}
+
+std::string QueuedPaths::Normalize(const std::filesystem::path& path) const {
+  auto normal = path.is_absolute() ? path : current_directory_ / path;
+  normal = normal.lexically_normal();
+  // a directory given as "music/" names the same files as "music".
+  if (!normal.has_filename() && normal.has_relative_path()) {
+    normal = normal.parent_path();
+  }
+  return normal.native();
+}
+
+bool QueuedPaths::Add(const std::filesystem::path& path) {
+  return paths_.insert(Normalize(path)).second;
+}
+
+bool QueuedPaths::AddFile(const std::filesystem::path& path) {
+  auto key = Normalize(path);
+  std::lock_guard<std::mutex> lock(files_mutex_);
+  return files_.insert(std::move(key)).second;
+}
+
+void QueueWavPaths(const std::vector<std::filesystem::path>& paths,
+                   WorkerPool& pool, WavFileHandler handler,
+                   const Shard& shard, QueuedPaths* queued) {
+  if (queued) {
+    // a file given by itself may also be found in a directory given before
+    // or after it, so every file is checked right before it is handled.
+    handler = [handler = std::move(handler), queued](
+                  const std::filesystem::path& path) {
+      if (queued->AddFile(path)) {
+        handler(path);
+      }
+    };
+  }
+  auto shared_handler = std::make_shared<WavFileHandler>(std::move(handler));
+  std::vector<FoundFile> files;
+  for (const auto& path : paths) {
+    if (queued && !queued->Add(path)) {
+      continue;
+    }
+    std::error_code error;
+    auto status = std::filesystem::status(path, error);
+    if (std::filesystem::is_directory(status)) {
+      QueueDirectory(path, pool, shared_handler, shard,
+                     GetShardRootSize(path));
+    } else if (!std::filesystem::is_regular_file(status)) {
+      printf("[ERROR] %s: cannot open file.\n", path.c_str());
+    } else if (!HasWavExtension(path.c_str(), path.native().size())) {
+      printf("[ERROR] %s: not a wav file.\n", path.c_str());
+    } else if (IsInShard(path, 0, shard)) {
+      // a file given by itself is hashed by its path as it is given, its
+      // name alone would put every take1.wav of a list in one shard.
+      auto size = std::filesystem::file_size(path, error);
+      files.push_back({path, error ? 0 : size});
+    }
+  }
+  QueueFiles(files, pool, shared_handler);
+}
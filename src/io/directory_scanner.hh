@@ -0,0 +1,89 @@
+#ifndef WASHMYWAVES_IO_DIRECTORY_SCANNER_H__
+#define WASHMYWAVES_IO_DIRECTORY_SCANNER_H__
+#include <filesystem> // for std::filesystem::path
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "utils/shard.hh"
+#include "utils/worker_pool.hh"
+
+// @desc - called on a worker thread for every wav file found.
+typedef std::function<void(const std::filesystem::path& file_name)>
+    WavFileHandler;
+
+// @desc - scans a directory and all of its subdirectories for .wav files on
+//         a worker pool. every directory is read by a task of its own, and
+//         subdirectory tasks are queued in front of other work so the scan
+//         keeps moving while files are encoded. files are queued as soon as
+//         their directory is read, the largest ones of each directory first,
+//         and files smaller than 1MiB are queued in batches.
+//         symbolic links to directories are not followed.
+// @param directory - root of the tree.
+// @param pool - pool that runs the scan and the handlers.
+// @param handler - called once for every file.
+// @param shard - only files of this shard are queued.
+// @param root - directory that files are sharded by their path below, see
+//        IsInShard(). directory itself if empty, a subdirectory of the tree
+//        that is scanned again passes the root of the tree.
+void ScanWavFiles(const std::filesystem::path& directory, WorkerPool& pool,
+                  WavFileHandler handler, const Shard& shard = Shard(),
+                  const std::filesystem::path& root = std::filesystem::path());
+
+// QueuedPaths remembers the paths QueueWavPaths() is given and the files it
+// hands out, so a file is converted once even if it is given twice, like on
+// the command line and in a list of paths, or both by itself and through a
+// directory above it. paths are compared once made absolute and normal,
+// links are not resolved.
+class QueuedPaths {
+public:
+  QueuedPaths();
+
+  // @desc - adds a path as it was given, a file or a directory. it is not
+  //         thread-safe.
+  // @return bool - false if it was added before.
+  bool Add(const std::filesystem::path& path);
+
+  // @desc - adds a file about to be handled, found in a directory or given
+  //         by itself. it is thread-safe.
+  // @return bool - false if it was added before.
+  bool AddFile(const std::filesystem::path& path);
+
+private:
+  // @desc - returns path made absolute and normal.
+  std::string Normalize(const std::filesystem::path& path) const;
+
+  // working directory that relative paths are made absolute with.
+  std::filesystem::path current_directory_;
+  std::unordered_set<std::string> paths_;
+  std::mutex files_mutex_;
+  std::unordered_set<std::string> files_;
+};
+
+// @desc - queues wav files and scans directories given by their paths, like
+//         the command line or a list of paths gives them. directories are
+//         scanned like ScanWavFiles() does. files are stat'ed on the calling
+//         thread and queued together, like the files of a directory.
+//         paths that do not exist or are not wav files are reported.
+// @param paths - paths of files and directories.
+// @param pool - pool that runs the scans and the handlers.
+// @param handler - called once for every file.
+// @param shard - only files of this shard are queued.
+// @param queued - paths queued before, paths in it are skipped and the
+//        others are added. files in it are not handled again, wherever they
+//        are found. it must outlive the tasks of the pool. nullptr queues
+//        every path.
+void QueueWavPaths(const std::vector<std::filesystem::path>& paths,
+                   WorkerPool& pool, WavFileHandler handler,
+                   const Shard& shard = Shard(),
+                   QueuedPaths* queued = nullptr);
+
+// @desc - checks, ignoring the case, if a file name ends with .wav.
+// @param name - the file name.
+// @param length - length of name.
+// @return bool
+bool HasWavExtension(const char* name, size_t length);
+
+#endif // WASHMYWAVES_IO_DIRECTORY_SCANNER_H__
@@ -0,0 +1,253 @@
+#ifdef __linux__
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#endif
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "io/directory_watcher.hh"
+#include "utils/metrics.hh"
+
+#ifdef __linux__
+// a file is ready once its writer closes it or it is renamed into the tree,
+// like tools that write to a temporary name do. directories are watched as
+// they are created or moved in, and forgotten as they are moved out.
+const uint32_t kWatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE |
+                            IN_MOVED_FROM | IN_ONLYDIR | IN_DONT_FOLLOW |
+                            IN_EXCL_UNLINK;
+
+// size of the buffer that events are read in.
+const size_t kEventBufferSize = 64 * 1024;
+
+// the watches of a tree.
+struct WatchedTree {
+  int fd;
+  // directory of every watch descriptor.
+  std::unordered_map<int, std::filesystem::path> directories;
+  // directory given to watch, files are sharded by their path below it.
+  std::filesystem::path root;
+};
+
+// PendingFiles are the files of a tree that are being converted. a file can
+// be queued twice, like one closed after its directory is watched but before
+// it is scanned, and two workers must not write the same mp3 file. a file
+// that comes up again while it is converted is converted once more by the
+// same worker afterwards, as it may have been written meanwhile.
+class PendingFiles {
+public:
+  // @desc - claims a file for a worker.
+  // @return bool - false if another worker has it, that worker then
+  //         converts it again.
+  bool Add(const std::filesystem::path& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto inserted = paths_.emplace(path.native(), false);
+    if (!inserted.second) {
+      inserted.first->second = true;
+    }
+    return inserted.second;
+  }
+
+  // @desc - releases a file once it is converted.
+  // @return bool - false if it came up again meanwhile and stays claimed.
+  bool Remove(const std::filesystem::path& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = paths_.find(path.native());
+    if (found->second) {
+      found->second = false;
+      return false;
+    }
+    paths_.erase(found);
+    return true;
+  }
+
+private:
+  std::mutex mutex_;
+  // claimed files, mapped to true if they came up again.
+  std::unordered_map<std::string, bool> paths_;
+};
+
+// @desc - returns the signals that stop watching.
+static sigset_t GetStopSignals() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  return signals;
+}
+
+void BlockStopSignals() {
+  auto signals = GetStopSignals();
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+}
+
+// @desc - watches a directory and its subdirectories. symbolic links to
+//         directories are not followed.
+// @return bool - false if the directory itself cannot be watched.
+static bool AddWatches(WatchedTree& tree,
+                       const std::filesystem::path& directory) {
+  int wd = inotify_add_watch(tree.fd, directory.c_str(), kWatchMask);
+  if (wd < 0) {
+    printf("[ERROR] %s: cannot watch directory: %s\n", directory.c_str(),
+           strerror(errno));
+    return false;
+  }
+  tree.directories[wd] = directory;
+
+  std::error_code error;
+  std::filesystem::directory_iterator iterator(directory, error), end;
+  for (; !error && iterator != end; iterator.increment(error)) {
+    std::error_code entry_error;
+    if (iterator->is_directory(entry_error) &&
+        !iterator->is_symlink(entry_error)) {
+      AddWatches(tree, iterator->path());
+    }
+  }
+  return true;
+}
+
+// @desc - stops watching a directory and its subdirectories.
+static void RemoveWatches(WatchedTree& tree,
+                          const std::filesystem::path& directory) {
+  for (auto it = tree.directories.begin(); it != tree.directories.end();) {
+    auto relative = it->second.lexically_relative(directory);
+    if (!relative.empty() && *relative.begin() != "..") {
+      inotify_rm_watch(tree.fd, it->first);
+      it = tree.directories.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// @desc - queues the file or watches the directory an event is about.
+static void HandleEvent(const inotify_event& event, WatchedTree& tree,
+                        WorkerPool& pool,
+                        const std::shared_ptr<WavFileHandler>& handler,
+                        const Shard& shard) {
+  if (event.mask & IN_IGNORED) {
+    tree.directories.erase(event.wd);
+    return;
+  }
+  auto found = tree.directories.find(event.wd);
+  if (found == tree.directories.end() || event.len == 0) {
+    return;
+  }
+  auto path = found->second / event.name;
+
+  if (event.mask & IN_ISDIR) {
+    if (event.mask & IN_MOVED_FROM) {
+      RemoveWatches(tree, path);
+    } else if (AddWatches(tree, path)) {
+      // files may have landed in it before it was watched.
+      ScanWavFiles(path, pool, *handler, shard, tree.root);
+    }
+    return;
+  }
+
+  if ((event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) &&
+      HasWavExtension(event.name, strlen(event.name)) &&
+      IsInShard(path, GetShardRootSize(tree.root), shard)) {
+    GetMetrics().files_found.Add();
+    pool.Submit([handler, path = std::move(path)] {
+      (*handler)(path);
+    });
+  }
+}
+
+bool WatchWavFiles(const std::filesystem::path& directory, WorkerPool& pool,
+                   WavFileHandler handler, const Shard& shard) {
+  auto signals = GetStopSignals();
+  int signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+  WatchedTree tree = {inotify_init1(IN_CLOEXEC), {}, directory};
+  if (signal_fd < 0 || tree.fd < 0) {
+    printf("[ERROR] %s: cannot watch directory: %s\n", directory.c_str(),
+           strerror(errno));
+    if (signal_fd >= 0) {
+      close(signal_fd);
+    }
+    if (tree.fd >= 0) {
+      close(tree.fd);
+    }
+    return false;
+  }
+
+  bool watching = AddWatches(tree, directory);
+  auto pending = std::make_shared<PendingFiles>();
+  auto shared_handler = std::make_shared<WavFileHandler>(
+      [pending, handler = std::move(handler)](
+          const std::filesystem::path& path) {
+        if (pending->Add(path)) {
+          do {
+            handler(path);
+          } while (!pending->Remove(path));
+        }
+      });
+  if (watching) {
+    ScanWavFiles(directory, pool, *shared_handler, shard);
+    printf("[DOING] %s: watching for wav files.\n", directory.c_str());
+  }
+
+  std::unique_ptr<char[]> buffer(new char[kEventBufferSize]);
+  while (watching) {
+    pollfd fds[2] = {{signal_fd, POLLIN, 0}, {tree.fd, POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) {
+      watching = errno == EINTR;
+      continue;
+    }
+    if (fds[0].revents) {
+      break;
+    }
+
+    auto bytes_read = read(tree.fd, buffer.get(), kEventBufferSize);
+    if (bytes_read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes_read <= 0) {
+      printf("[ERROR] %s: cannot read events: %s\n", directory.c_str(),
+             strerror(errno));
+      watching = false;
+      break;
+    }
+    for (long offset = 0; offset < bytes_read;) {
+      auto event = (const inotify_event*)(buffer.get() + offset);
+      offset += sizeof(inotify_event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        // events were dropped, so the whole tree is watched and scanned
+        // again. a file found while it is converted is converted once more
+        // after that, never on two workers at once.
+        printf("[ERROR] %s: too many events, scanning the tree again.\n",
+               directory.c_str());
+        AddWatches(tree, directory);
+        ScanWavFiles(directory, pool, *shared_handler, shard);
+        continue;
+      }
+      HandleEvent(*event, tree, pool, shared_handler, shard);
+    }
+    if (tree.directories.empty()) {
+      printf("[ERROR] %s: directory is gone.\n", directory.c_str());
+      watching = false;
+    }
+  }
+
+  close(tree.fd);
+  close(signal_fd);
+  return watching;
+}
+#else
+void BlockStopSignals() {
+}
+
+bool WatchWavFiles(const std::filesystem::path& directory, WorkerPool& pool,
+                   WavFileHandler handler, const Shard& shard) {
+  printf("[ERROR] %s: watching is only supported on linux.\n",
+         directory.c_str());
+  return false;
+}
+#endif // __linux__
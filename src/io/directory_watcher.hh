@@ -0,0 +1,31 @@
+#ifndef WASHMYWAVES_IO_DIRECTORY_WATCHER_H__
+#define WASHMYWAVES_IO_DIRECTORY_WATCHER_H__
+#include <filesystem> // for std::filesystem::path
+
+#include "io/directory_scanner.hh"
+#include "utils/worker_pool.hh"
+
+// @desc - blocks SIGINT and SIGTERM in the calling thread and in the threads
+//         it starts afterwards, so they stop WatchWavFiles() instead of
+//         killing the process. it has to be called before the worker pool
+//         is created.
+void BlockStopSignals();
+
+// @desc - watches a directory and all of its subdirectories with inotify,
+//         and queues every .wav file as soon as it is closed after writing
+//         or moved into the tree. each file is a task of its own, so it is
+//         picked up by the next free worker. files already in the tree are
+//         queued like ScanWavFiles() does, once the watches are set up so
+//         no file is missed in between. new subdirectories are watched and
+//         scanned. it returns on SIGINT or SIGTERM, blocked beforehand by
+//         BlockStopSignals(), without waiting for the queued files.
+//         only supported on linux.
+// @param directory - root of the tree.
+// @param pool - pool that runs the handlers.
+// @param handler - called for every file.
+// @param shard - only files of this shard are queued.
+// @return bool - false if the tree cannot be watched.
+bool WatchWavFiles(const std::filesystem::path& directory, WorkerPool& pool,
+                   WavFileHandler handler, const Shard& shard = Shard());
+
+#endif // WASHMYWAVES_IO_DIRECTORY_WATCHER_H__
@@ -0,0 +1,96 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#include "io/mapped_source.hh"
+
+std::unique_ptr<MappedSource> MappedSource::Open(
+    const std::filesystem::path& file_name) {
+  // pipes and other special files are checked before opening them, opening a
+  // fifo would block until a writer shows up and consume it.
+  struct stat file_stat;
+  if (stat(file_name.c_str(), &file_stat) != 0 ||
+      !S_ISREG(file_stat.st_mode) || file_stat.st_size == 0) {
+    return nullptr;
+  }
+
+  int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  // the file might have been replaced between stat and open.
+  if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) ||
+      file_stat.st_size == 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  auto data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps a reference to the file.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  // data is read from start to end, the kernel can read ahead aggressively
+  // and drop pages soon after they are used.
+  madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+
+  return std::unique_ptr<MappedSource>(
+      new MappedSource((const uint8_t*)data, file_stat.st_size));
+}
+
+MappedSource::MappedSource(const uint8_t* data, uint64_t size)
+    : data_(data), size_(size) {}
+
+MappedSource::~MappedSource() {
+  munmap((void*)data_, size_);
+}
+
+size_t MappedSource::Read(void* buffer, size_t size) {
+  const uint8_t* data;
+  auto bytes_read = Fetch(size, &data);
+  std::memcpy(buffer, data, bytes_read);
+  return bytes_read;
+}
+
+size_t MappedSource::Fetch(size_t size, const uint8_t** data) {
+  // the memory returned by the previous call is not used anymore.
+  if (position_ >= released_ + kReleaseSize) {
+    ReleaseBefore(position_);
+  }
+
+  auto bytes_read = (size_t)std::min<uint64_t>(size, size_ - position_);
+  *data = data_ + position_;
+  position_ += bytes_read;
+  return bytes_read;
+}
+
+bool MappedSource::Seek(uint64_t offset) {
+  if (offset > size_) {
+    return false;
+  }
+  position_ = offset;
+  return true;
+}
+
+uint64_t MappedSource::Tell() const {
+  return position_;
+}
+
+uint64_t MappedSource::GetSize() const {
+  return size_;
+}
+
+void MappedSource::ReleaseBefore(uint64_t offset) {
+  static const uint64_t page_size = sysconf(_SC_PAGESIZE);
+  // only whole pages can be released.
+  auto begin = released_ / page_size * page_size;
+  auto end = offset / page_size * page_size;
+  if (end > begin) {
+    madvise((void*)(data_ + begin), end - begin, MADV_DONTNEED);
+  }
+  released_ = offset;
+}
@@ -0,0 +1,48 @@
+#ifndef WASHMYWAVES_IO_MAPPED_SOURCE_H__
+#define WASHMYWAVES_IO_MAPPED_SOURCE_H__
+#include <memory>
+
+#include "io/source.hh"
+
+// MappedSource reads from a memory-mapped file. Fetch() returns pointers into
+// the mapping, so sample data is never copied nor read by system calls.
+class MappedSource : public Source {
+public:
+  // @desc - maps a regular file into memory.
+  // @param file_name - path to the file.
+  // @return std::unique_ptr<MappedSource> - the source, nullptr if the file
+  //         cannot be mapped, for example if it is a pipe or empty.
+  static std::unique_ptr<MappedSource> Open(
+      const std::filesystem::path& file_name);
+
+  ~MappedSource();
+
+  MappedSource(const MappedSource&) = delete;
+  MappedSource& operator=(const MappedSource&) = delete;
+
+  size_t Read(void* buffer, size_t size) override;
+  size_t Fetch(size_t size, const uint8_t** data) override;
+  bool Seek(uint64_t offset) override;
+  uint64_t Tell() const override;
+  uint64_t GetSize() const override;
+
+private:
+  // pages behind the fetch cursor are released once this many bytes of them
+  // are accumulated.
+  static const uint64_t kReleaseSize = 8 << 20;
+
+  const uint8_t* data_;
+  uint64_t size_;
+  uint64_t position_ = 0;
+  // everything before this offset is already released.
+  uint64_t released_ = 0;
+
+  MappedSource(const uint8_t* data, uint64_t size);
+
+  // @desc - drops the pages before offset from the process, the kernel reads
+  //         them back from the page cache if they are touched again.
+  // @param offset - end of the range to release.
+  void ReleaseBefore(uint64_t offset);
+};
+
+#endif // WASHMYWAVES_IO_MAPPED_SOURCE_H__
@@ -0,0 +1,38 @@
+#include <algorithm>
+#include <cstring>
+
+#include "io/memory_source.hh"
+
+MemorySource::MemorySource(const uint8_t* data, uint64_t size)
+    : data_(data), size_(size) {
+}
+
+size_t MemorySource::Read(void* buffer, size_t size) {
+  const uint8_t* data;
+  auto bytes_read = Fetch(size, &data);
+  std::memcpy(buffer, data, bytes_read);
+  return bytes_read;
+}
+
+size_t MemorySource::Fetch(size_t size, const uint8_t** data) {
+  auto bytes_read = (size_t)std::min<uint64_t>(size, size_ - position_);
+  *data = data_ + position_;
+  position_ += bytes_read;
+  return bytes_read;
+}
+
+bool MemorySource::Seek(uint64_t offset) {
+  if (offset > size_) {
+    return false;
+  }
+  position_ = offset;
+  return true;
+}
+
+uint64_t MemorySource::Tell() const {
+  return position_;
+}
+
+uint64_t MemorySource::GetSize() const {
+  return size_;
+}
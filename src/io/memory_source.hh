@@ -0,0 +1,29 @@
+#ifndef WASHMYWAVES_IO_MEMORY_SOURCE_H__
+#define WASHMYWAVES_IO_MEMORY_SOURCE_H__
+#include <cstddef>
+#include <cstdint>
+
+#include "io/source.hh"
+
+// MemorySource reads from a buffer in memory, like a file uploaded to a
+// program that embeds the encoder, or the inputs of the benchmarks. it
+// behaves like MappedSource without the page management.
+class MemorySource : public Source {
+public:
+  // @param data - the input, it must outlive the object.
+  // @param size - size of the input in bytes.
+  MemorySource(const uint8_t* data, uint64_t size);
+
+  size_t Read(void* buffer, size_t size) override;
+  size_t Fetch(size_t size, const uint8_t** data) override;
+  bool Seek(uint64_t offset) override;
+  uint64_t Tell() const override;
+  uint64_t GetSize() const override;
+
+private:
+  const uint8_t* data_;
+  uint64_t size_;
+  uint64_t position_ = 0;
+};
+
+#endif // WASHMYWAVES_IO_MEMORY_SOURCE_H__
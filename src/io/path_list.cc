@@ -0,0 +1,51 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "io/path_list.hh"
+
+// number of paths read before they are queued. the first files start
+// converting right away, and a list of millions of paths is not held in
+// memory at once.
+const size_t kPathsPerChunk = 1024;
+
+bool QueueListedPaths(const char* list_path, char separator, WorkerPool& pool,
+                      const WavFileHandler& handler, const Shard& shard,
+                      QueuedPaths* queued) {
+  std::ifstream list_file;
+  bool from_stdin = strcmp(list_path, "-") == 0;
+  if (!from_stdin) {
+    list_file.open(list_path, std::ios::binary);
+    if (!list_file.is_open()) {
+      printf("[ERROR] %s: cannot open list.\n", list_path);
+      return false;
+    }
+  }
+  std::istream& list = from_stdin ? std::cin : list_file;
+
+  std::vector<std::filesystem::path> paths;
+  std::string entry;
+  while (std::getline(list, entry, separator)) {
+    // lists written on windows end their lines with \r\n.
+    if (separator == '\n' && !entry.empty() && entry.back() == '\r') {
+      entry.pop_back();
+    }
+    if (entry.empty()) {
+      continue;
+    }
+    paths.emplace_back(entry);
+    if (paths.size() == kPathsPerChunk) {
+      QueueWavPaths(paths, pool, handler, shard, queued);
+      paths.clear();
+    }
+  }
+  QueueWavPaths(paths, pool, handler, shard, queued);
+
+  if (list.bad()) {
+    printf("[ERROR] %s: cannot read list.\n", list_path);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,22 @@
+#ifndef WASHMYWAVES_IO_PATH_LIST_H__
+#define WASHMYWAVES_IO_PATH_LIST_H__
+#include "io/directory_scanner.hh"
+#include "utils/shard.hh"
+#include "utils/worker_pool.hh"
+
+// @desc - reads a list of paths of wav files and directories, and queues
+//         them in chunks with QueueWavPaths(), so files are converted while
+//         the rest of the list is read. empty entries are skipped.
+// @param list_path - file of the list, "-" reads it from stdin.
+// @param separator - '\n' for a list of lines, '\0' for a list like
+//        `find -print0` writes, which can hold any file name.
+// @param pool - pool that runs the scans and the handlers.
+// @param handler - called once for every file.
+// @param shard - only files of this shard are queued.
+// @param queued - paths queued before, see QueueWavPaths().
+// @return bool - false if the list cannot be read.
+bool QueueListedPaths(const char* list_path, char separator, WorkerPool& pool,
+                      const WavFileHandler& handler, const Shard& shard,
+                      QueuedPaths* queued);
+
+#endif // WASHMYWAVES_IO_PATH_LIST_H__
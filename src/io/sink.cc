@@ -0,0 +1,108 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "io/sink.hh"
+#include "io/uring_sink.hh"
+
+FileSink::FileSink(const std::filesystem::path& file_name)
+    : buffer_size_(kBufferSize), buffer_(kBufferSize) {
+  fd_ = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+             0666);
+}
+
+FileSink::FileSink(int fd) : fd_(fd), buffer_size_(0) {
+}
+
+FileSink::~FileSink() {
+  Close();
+}
+
+bool FileSink::Write(const void* data, size_t size) {
+  auto bytes = (const uint8_t*)data;
+  if (buffer_size_ == 0) {
+    WriteAll(bytes, size);
+    return !failed_;
+  }
+  while (size > 0 && !failed_) {
+    auto bytes_to_copy = std::min(size, buffer_size_ - buffer_used_);
+    memcpy(buffer_.GetData() + buffer_used_, bytes, bytes_to_copy);
+    buffer_used_ += bytes_to_copy;
+    bytes += bytes_to_copy;
+    size -= bytes_to_copy;
+    if (buffer_used_ == buffer_size_) {
+      Flush();
+    }
+  }
+  return !failed_;
+}
+
+bool FileSink::Close() {
+  if (fd_ < 0) {
+    return !failed_;
+  }
+  Flush();
+  if (close(fd_) != 0) {
+    failed_ = true;
+  }
+  fd_ = -1;
+  return !failed_;
+}
+
+bool FileSink::IsOpen() const {
+  return fd_ >= 0;
+}
+
+void FileSink::Flush() {
+  WriteAll(buffer_.GetData(), buffer_used_);
+  buffer_used_ = 0;
+}
+
+void FileSink::WriteAll(const uint8_t* data, size_t size) {
+  size_t written = 0;
+  while (written < size && !failed_) {
+    auto bytes = write(fd_, data + written, size - written);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      failed_ = true;
+      break;
+    }
+    written += bytes;
+  }
+}
+
+CallbackSink::CallbackSink(const WriteCallback& write) : write_(write) {
+}
+
+bool CallbackSink::Write(const void* data, size_t size) {
+  if (size > 0 && !failed_) {
+    failed_ = !write_(data, size);
+  }
+  return !failed_;
+}
+
+bool CallbackSink::Close() {
+  return !failed_;
+}
+
+std::unique_ptr<Sink> OpenSink(const std::filesystem::path& file_name,
+                               IOBackend backend) {
+#ifdef __linux__
+  if (backend == IOBackend::kUring) {
+    auto uring_sink = UringSink::Open(file_name);
+    if (uring_sink) {
+      return uring_sink;
+    }
+  }
+#endif
+
+  std::unique_ptr<FileSink> file_sink(new FileSink(file_name));
+  if (!file_sink->IsOpen()) {
+    return nullptr;
+  }
+  return file_sink;
+}
@@ -0,0 +1,110 @@
+#ifndef WASHMYWAVES_IO_SINK_H__
+#define WASHMYWAVES_IO_SINK_H__
+#include <cstddef>
+#include <filesystem> // for std::filesystem::path
+#include <functional>
+#include <memory>
+
+#include "io/source.hh"
+#include "utils/buffer_pool.hh"
+
+// Sink is the output that mp3 data is written to. writes may complete after
+// Write() returns, their errors are then reported by a later call.
+class Sink {
+public:
+  virtual ~Sink() {}
+
+  // a sink is created for every file, they are allocated from the buffer
+  // pool of the thread.
+  static void* operator new(size_t size) {
+    return BufferPool::Allocate(size);
+  }
+  static void operator delete(void* data, size_t size) {
+    BufferPool::Free(data, size);
+  }
+
+  // @desc - appends bytes to the output.
+  // @param data - the bytes.
+  // @param size - number of bytes.
+  // @return bool - false on error.
+  virtual bool Write(const void* data, size_t size) = 0;
+
+  // @desc - writes everything still buffered and closes the output. it is
+  //         called by the destructor if the caller did not.
+  // @return bool - false if any write failed.
+  virtual bool Close() = 0;
+};
+
+// FileSink writes to a file with blocking writes. data is gathered in a
+// pooled buffer and written when it is full.
+class FileSink : public Sink {
+public:
+  // @param file_name - path to the file, it is created or truncated.
+  FileSink(const std::filesystem::path& file_name);
+
+  // @desc - writes to a descriptor which is already open, like stdout of a
+  //         pipeline. data is written as it comes instead of being gathered,
+  //         so the reader gets it without delay.
+  // @param fd - the descriptor, it is closed with the sink.
+  explicit FileSink(int fd);
+
+  ~FileSink();
+
+  FileSink(const FileSink&) = delete;
+  FileSink& operator=(const FileSink&) = delete;
+
+  bool Write(const void* data, size_t size) override;
+  bool Close() override;
+
+  // @desc - checks if the file is opened.
+  // @return bool
+  bool IsOpen() const;
+
+private:
+  // size of the buffer writes are gathered in.
+  static const size_t kBufferSize = 64 * 1024;
+
+  int fd_;
+  // 0 if data is written as it comes.
+  size_t buffer_size_;
+  PooledBuffer buffer_;
+  size_t buffer_used_ = 0;
+  bool failed_ = false;
+
+  // @desc - writes the buffered data to the file.
+  void Flush();
+
+  // @desc - writes bytes to the file, sets failed_ on error.
+  void WriteAll(const uint8_t* data, size_t size);
+};
+
+// CallbackSink hands data to a function of the caller as it is written,
+// without gathering it.
+class CallbackSink : public Sink {
+public:
+  // @desc - takes the next bytes of output.
+  // @param data - the bytes, valid only during the call.
+  // @param size - number of bytes.
+  // @return bool - false to fail the write.
+  typedef std::function<bool(const void* data, size_t size)> WriteCallback;
+
+  // @param write - the function, it must outlive the sink.
+  explicit CallbackSink(const WriteCallback& write);
+
+  bool Write(const void* data, size_t size) override;
+  bool Close() override;
+
+private:
+  const WriteCallback& write_;
+  bool failed_ = false;
+};
+
+// @desc - creates a file for writing.
+// @param file_name - path to the file, it is created or truncated.
+// @param backend - the backend to write with. it falls back to a stream if
+//        the backend is not available.
+// @return std::unique_ptr<Sink> - the sink, nullptr on error.
+std::unique_ptr<Sink> OpenSink(const std::filesystem::path& file_name,
+                               IOBackend backend = IOBackend::kBlocking);
+
+#endif // WASHMYWAVES_IO_SINK_H__
@@ -0,0 +1,31 @@
+#include <fstream>
+
+#include "io/source.hh"
+#include "io/mapped_source.hh"
+#include "io/stream_source.hh"
+#include "io/uring_source.hh"
+
+std::unique_ptr<Source> OpenSource(const std::filesystem::path& file_name,
+                                   IOBackend backend) {
+#ifdef __linux__
+  if (backend == IOBackend::kUring) {
+    auto uring_source = UringSource::Open(file_name);
+    if (uring_source) {
+      return uring_source;
+    }
+  }
+#endif
+
+  auto mapped_source = MappedSource::Open(file_name);
+  if (mapped_source) {
+    return mapped_source;
+  }
+
+  // files that cannot be mapped, like pipes, are read through a stream.
+  std::unique_ptr<std::istream> input_file(
+      new std::ifstream(file_name, std::ios::binary));
+  if (!*input_file) {
+    return nullptr;
+  }
+  return std::unique_ptr<Source>(new StreamSource(std::move(input_file)));
+}
@@ -0,0 +1,74 @@
+#ifndef WASHMYWAVES_IO_SOURCE_H__
+#define WASHMYWAVES_IO_SOURCE_H__
+#include <cstddef>
+#include <cstdint>
+#include <filesystem> // for std::filesystem::path
+#include <memory>
+
+#include "utils/buffer_pool.hh"
+
+// Source is the input that a wav file is parsed and decoded from. it hides
+// whether bytes come from a stream or straight from a memory mapping.
+class Source {
+public:
+  virtual ~Source() {}
+
+  // a source is created for every file, they are allocated from the buffer
+  // pool of the thread.
+  static void* operator new(size_t size) {
+    return BufferPool::Allocate(size);
+  }
+  static void operator delete(void* data, size_t size) {
+    BufferPool::Free(data, size);
+  }
+
+  // @desc - copies bytes from the current position and moves past them.
+  // @param buffer - destination buffer of at least size bytes.
+  // @param size - number of bytes to copy.
+  // @return size_t - number of bytes copied, less than size only at the end
+  //         of input.
+  virtual size_t Read(void* buffer, size_t size) = 0;
+
+  // @desc - returns bytes from the current position without copying them, if
+  //         the backend allows it, and moves past them. the returned memory
+  //         is valid until the next call to Fetch() or Seek().
+  // @param size - number of bytes wanted.
+  // @param data - receives a pointer to the bytes.
+  // @return size_t - number of bytes available at *data, less than size only
+  //         at the end of input.
+  virtual size_t Fetch(size_t size, const uint8_t** data) = 0;
+
+  // @desc - moves the current position.
+  // @param offset - new position from the beginning of input.
+  // @return bool - false if the source is not seekable or on error.
+  virtual bool Seek(uint64_t offset) = 0;
+
+  // @desc - returns the current position from the beginning of input.
+  // @return uint64_t
+  virtual uint64_t Tell() const = 0;
+
+  // @desc - returns size of the whole input.
+  // @return uint64_t - size in bytes, 0 if it is not known.
+  virtual uint64_t GetSize() const = 0;
+};
+
+// IOBackend selects how files are read and written.
+enum class IOBackend {
+  // files are memory-mapped, or read through a stream, and written through
+  // a stream.
+  kBlocking,
+  // reads and writes are queued on an io_uring of each thread. files which
+  // cannot be handled by it fall back to kBlocking.
+  kUring,
+};
+
+// @desc - opens a file for reading. with the blocking backend the file is
+//         memory-mapped when possible, and read through a stream otherwise,
+//         for example for pipes.
+// @param file_name - path to the file.
+// @param backend - the backend to read with.
+// @return std::unique_ptr<Source> - the source, nullptr on error.
+std::unique_ptr<Source> OpenSource(const std::filesystem::path& file_name,
+                                   IOBackend backend = IOBackend::kBlocking);
+
+#endif // WASHMYWAVES_IO_SOURCE_H__
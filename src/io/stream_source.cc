@@ -0,0 +1,75 @@
+#include <algorithm>
+
+#include "io/stream_source.hh"
+
+StreamSource::StreamSource(std::istream& input) : input_(input) {
+  // streams like pipes cannot tell their position. their size is unknown and
+  // they are read from where they are.
+  auto position = input_.tellg();
+  if (position >= 0) {
+    input_.seekg(0, std::ios::end);
+    auto size = input_.tellg();
+    input_.seekg(position);
+    position_ = position;
+    size_ = size >= 0 ? (uint64_t)size : 0;
+    seekable_ = true;
+  }
+  input_.clear();
+}
+
+StreamSource::StreamSource(std::unique_ptr<std::istream> input)
+    : StreamSource(*input) {
+  owned_input_ = std::move(input);
+}
+
+size_t StreamSource::Read(void* buffer, size_t size) {
+  input_.read((char*)buffer, size);
+  size_t bytes_read = input_.gcount();
+  // a short read at the end of input leaves the stream in a failed state,
+  // which would break the next seek.
+  input_.clear();
+  position_ += bytes_read;
+  return bytes_read;
+}
+
+size_t StreamSource::Fetch(size_t size, const uint8_t** data) {
+  if (buffer_.size() < size) {
+    buffer_.resize(size);
+  }
+  *data = buffer_.data();
+  return Read(buffer_.data(), size);
+}
+
+bool StreamSource::Seek(uint64_t offset) {
+  if (!seekable_) {
+    // pipes can only move forward, by reading and dropping bytes.
+    if (offset < position_) {
+      return false;
+    }
+    char skipped[4096];
+    while (position_ < offset) {
+      auto size = (size_t)std::min<uint64_t>(sizeof(skipped),
+                                             offset - position_);
+      if (Read(skipped, size) != size) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  input_.seekg(offset);
+  if (!input_) {
+    input_.clear();
+    return false;
+  }
+  position_ = offset;
+  return true;
+}
+
+uint64_t StreamSource::Tell() const {
+  return position_;
+}
+
+uint64_t StreamSource::GetSize() const {
+  return size_;
+}
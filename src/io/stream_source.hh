@@ -0,0 +1,37 @@
+#ifndef WASHMYWAVES_IO_STREAM_SOURCE_H__
+#define WASHMYWAVES_IO_STREAM_SOURCE_H__
+#include <istream>
+#include <memory>
+#include <vector>
+
+#include "io/source.hh"
+
+// StreamSource reads from a std::istream. Fetch() copies the bytes into an
+// internal buffer, which grows to the largest size requested. streams which
+// cannot tell their position, like pipes, can only seek forward.
+class StreamSource : public Source {
+public:
+  // @desc - reads from a stream owned by the caller.
+  // @param input - the stream, it must outlive the source.
+  StreamSource(std::istream& input);
+
+  // @desc - reads from a stream owned by the source.
+  // @param input - the stream.
+  StreamSource(std::unique_ptr<std::istream> input);
+
+  size_t Read(void* buffer, size_t size) override;
+  size_t Fetch(size_t size, const uint8_t** data) override;
+  bool Seek(uint64_t offset) override;
+  uint64_t Tell() const override;
+  uint64_t GetSize() const override;
+
+private:
+  std::unique_ptr<std::istream> owned_input_;
+  std::istream& input_;
+  std::vector<uint8_t> buffer_;
+  uint64_t position_ = 0;
+  uint64_t size_ = 0;
+  bool seekable_ = false;
+};
+
+#endif // WASHMYWAVES_IO_STREAM_SOURCE_H__
@@ -0,0 +1,280 @@
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include "io/uring.hh"
+
+// number of entries of the submission queue. each registered buffer is used
+// by at most one request at a time, so the queue can never be full.
+const unsigned int kRingEntries = 2 * Uring::kNumberOfBuffers;
+
+// number of times a submission the kernel has no room for is retried, with
+// a backoff that doubles from 1us, before it fails.
+const int kMaxSubmitRetries = 16;
+
+// number of times in a row io_uring_enter() may fail while waiting for a
+// completion before the ring is given up.
+const int kMaxWaitErrors = 3;
+
+// set once setting up a ring failed, the other threads do not try again.
+static std::atomic<bool> uring_unavailable(false);
+
+// the parts of the rings which are shared with the kernel.
+struct Uring::Ring {
+  int fd = -1;
+  void* sq_ring = MAP_FAILED;
+  size_t sq_ring_size = 0;
+  void* cq_ring = MAP_FAILED;
+  size_t cq_ring_size = 0;
+  io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+  size_t sqes_size = 0;
+
+  unsigned int* sq_head;
+  unsigned int* sq_tail;
+  unsigned int* sq_mask;
+  unsigned int* sq_array;
+  unsigned int* cq_head;
+  unsigned int* cq_tail;
+  unsigned int* cq_mask;
+  io_uring_cqe* cqes;
+};
+
+Uring* Uring::GetThreadRing() {
+  static thread_local std::unique_ptr<Uring> ring;
+  static thread_local bool tried = false;
+  if (!tried && !uring_unavailable) {
+    tried = true;
+    std::unique_ptr<Uring> new_ring(new Uring());
+    if (new_ring->Setup()) {
+      ring = std::move(new_ring);
+    } else {
+      uring_unavailable = true;
+    }
+  }
+  return ring.get();
+}
+
+Uring::Uring() : ring_(new Ring()) {}
+
+Uring::~Uring() {
+  auto& ring = *ring_;
+  if (ring.fd >= 0) {
+    close(ring.fd);
+  }
+  if (ring.sqes != MAP_FAILED) {
+    munmap(ring.sqes, ring.sqes_size);
+  }
+  if (ring.cq_ring != MAP_FAILED && ring.cq_ring != ring.sq_ring) {
+    munmap(ring.cq_ring, ring.cq_ring_size);
+  }
+  if (ring.sq_ring != MAP_FAILED) {
+    munmap(ring.sq_ring, ring.sq_ring_size);
+  }
+  if (buffers_) {
+    munmap(buffers_, kBufferSize * kNumberOfBuffers);
+  }
+}
+
+bool Uring::Setup() {
+  auto& ring = *ring_;
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring.fd = syscall(__NR_io_uring_setup, kRingEntries, &params);
+  if (ring.fd < 0) {
+    ring.fd = -1;
+    return false;
+  }
+
+  // map the rings. with IORING_FEAT_SINGLE_MMAP both rings share one
+  // mapping.
+  ring.sq_ring_size = params.sq_off.array +
+                      params.sq_entries * sizeof(unsigned int);
+  ring.cq_ring_size = params.cq_off.cqes +
+                      params.cq_entries * sizeof(io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap && ring.cq_ring_size > ring.sq_ring_size) {
+    ring.sq_ring_size = ring.cq_ring_size;
+  }
+  ring.sq_ring = mmap(nullptr, ring.sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+  if (ring.sq_ring == MAP_FAILED) {
+    return false;
+  }
+  if (single_mmap) {
+    ring.cq_ring = ring.sq_ring;
+  } else {
+    ring.cq_ring = mmap(nullptr, ring.cq_ring_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring.fd,
+                        IORING_OFF_CQ_RING);
+    if (ring.cq_ring == MAP_FAILED) {
+      return false;
+    }
+  }
+  ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  ring.sqes = (io_uring_sqe*)mmap(nullptr, ring.sqes_size,
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, ring.fd,
+                                  IORING_OFF_SQES);
+  if (ring.sqes == MAP_FAILED) {
+    return false;
+  }
+
+  auto sq = (uint8_t*)ring.sq_ring;
+  ring.sq_head = (unsigned int*)(sq + params.sq_off.head);
+  ring.sq_tail = (unsigned int*)(sq + params.sq_off.tail);
+  ring.sq_mask = (unsigned int*)(sq + params.sq_off.ring_mask);
+  ring.sq_array = (unsigned int*)(sq + params.sq_off.array);
+  auto cq = (uint8_t*)ring.cq_ring;
+  ring.cq_head = (unsigned int*)(cq + params.cq_off.head);
+  ring.cq_tail = (unsigned int*)(cq + params.cq_off.tail);
+  ring.cq_mask = (unsigned int*)(cq + params.cq_off.ring_mask);
+  ring.cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+  // registered buffers are pinned by the kernel once, instead of on every
+  // request.
+  auto buffers = mmap(nullptr, kBufferSize * kNumberOfBuffers,
+                      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                      -1, 0);
+  if (buffers == MAP_FAILED) {
+    return false;
+  }
+  buffers_ = (uint8_t*)buffers;
+  iovec iovecs[kNumberOfBuffers];
+  for (int i = 0; i < kNumberOfBuffers; i++) {
+    iovecs[i].iov_base = buffers_ + i * kBufferSize;
+    iovecs[i].iov_len = kBufferSize;
+  }
+  return syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS,
+                 iovecs, kNumberOfBuffers) == 0;
+}
+
+int Uring::AcquireBuffer() {
+  for (int i = 0; i < kNumberOfBuffers; i++) {
+    if (!(taken_buffers_ & (1u << i))) {
+      taken_buffers_ |= 1u << i;
+      return i;
+    }
+  }
+  return -1;
+}
+
+void Uring::ReleaseBuffer(int buffer) {
+  taken_buffers_ &= ~(1u << buffer);
+}
+
+uint8_t* Uring::GetBuffer(int buffer) const {
+  return buffers_ + buffer * kBufferSize;
+}
+
+bool Uring::QueueRead(UringRequest& request, int fd, int buffer, size_t size,
+                      uint64_t offset) {
+  return Queue(IORING_OP_READ_FIXED, request, fd, buffer, size, offset);
+}
+
+bool Uring::QueueWrite(UringRequest& request, int fd, int buffer,
+                       size_t size, uint64_t offset) {
+  return Queue(IORING_OP_WRITE_FIXED, request, fd, buffer, size, offset);
+}
+
+bool Uring::Queue(uint8_t opcode, UringRequest& request, int fd, int buffer,
+                  size_t size, uint64_t offset) {
+  if (failed_) {
+    request.done = true;
+    request.result = -EIO;
+    return false;
+  }
+  auto& ring = *ring_;
+  auto tail = *ring.sq_tail;
+  auto index = tail & *ring.sq_mask;
+  auto sqe = &ring.sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->off = offset;
+  sqe->addr = (uint64_t)GetBuffer(buffer);
+  sqe->len = size;
+  sqe->buf_index = buffer;
+  sqe->user_data = (uint64_t)&request;
+  ring.sq_array[index] = index;
+  // the kernel must see the entry before it sees the new tail.
+  __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  request.done = false;
+  int retries = 0;
+  while (syscall(__NR_io_uring_enter, ring.fd, 1, 0, 0, nullptr, 0) < 0) {
+    if (errno == EINTR) {
+      continue;
+    }
+    // EAGAIN and EBUSY mean the kernel has no room for the request, usually
+    // because the completion queue is full. completions are reaped to make
+    // room, waiting for one if requests are in flight.
+    bool no_room = errno == EAGAIN || errno == EBUSY;
+    if (no_room && retries < kMaxSubmitRetries) {
+      Reap();
+      if (in_flight_ > 0) {
+        syscall(__NR_io_uring_enter, ring.fd, 0, 1, IORING_ENTER_GETEVENTS,
+                nullptr, 0);
+        Reap();
+      } else {
+        timespec backoff = {0, 1000L << retries};
+        nanosleep(&backoff, nullptr);
+      }
+      retries++;
+      continue;
+    }
+    // nothing was consumed by the kernel, the entry is taken back.
+    __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+    request.done = true;
+    request.result = no_room ? -EAGAIN : -errno;
+    return false;
+  }
+  in_flight_++;
+  return true;
+}
+
+void Uring::Reap() {
+  if (failed_) {
+    return;
+  }
+  auto& ring = *ring_;
+  auto head = *ring.cq_head;
+  auto tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    auto& cqe = ring.cqes[head & *ring.cq_mask];
+    auto request = (UringRequest*)cqe.user_data;
+    request->result = cqe.res;
+    request->done = true;
+    in_flight_--;
+  }
+  __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+}
+
+void Uring::Wait(UringRequest& request) {
+  Reap();
+  int errors = 0;
+  while (!request.done) {
+    if (syscall(__NR_io_uring_enter, ring_->fd, 0, 1, IORING_ENTER_GETEVENTS,
+                nullptr, 0) < 0 && errno != EINTR) {
+      if (++errors >= kMaxWaitErrors) {
+        // the ring is broken, like after EBADF or EFAULT. its requests are
+        // failed and never reaped, so a late completion cannot reach a
+        // request that is gone. later requests fail at once.
+        failed_ = true;
+        request.result = -errno;
+        request.done = true;
+        return;
+      }
+    } else {
+      errors = 0;
+    }
+    Reap();
+  }
+}
+#endif // __linux__
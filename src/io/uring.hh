@@ -0,0 +1,105 @@
+#ifndef WASHMYWAVES_IO_URING_H__
+#define WASHMYWAVES_IO_URING_H__
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// UringRequest is a read or write queued on a Uring. it must stay alive
+// until the request is done.
+struct UringRequest {
+  // false while the request is in flight.
+  bool done = true;
+  // bytes transferred, or -errno on error.
+  int result = 0;
+};
+
+// Uring is a minimal io_uring instance, set up with raw system calls so no
+// library is needed. every thread has its own ring together with a small
+// set of buffers registered with the kernel, and reads and writes are done
+// from those buffers with the fixed-buffer operations. a ring is only used
+// by the thread that owns it, so nothing in it is locked.
+class Uring {
+public:
+  // size of each registered buffer.
+  static constexpr size_t kBufferSize = 1 << 20;
+  // number of registered buffers of each ring.
+  static constexpr int kNumberOfBuffers = 8;
+
+  // @desc - returns the ring of the current thread, it is created on the
+  //         first call.
+  // @return Uring* - nullptr if io_uring is not available, for example on
+  //         old kernels or when it is blocked by seccomp.
+  static Uring* GetThreadRing();
+
+  ~Uring();
+
+  Uring(const Uring&) = delete;
+  Uring& operator=(const Uring&) = delete;
+
+  // @desc - takes a registered buffer.
+  // @return int - index of the buffer, -1 if all of them are taken.
+  int AcquireBuffer();
+
+  // @desc - gives a buffer back. no request may use it anymore.
+  // @param buffer - index of the buffer.
+  void ReleaseBuffer(int buffer);
+
+  // @desc - returns memory of a registered buffer.
+  // @param buffer - index of the buffer.
+  // @return uint8_t* - kBufferSize bytes.
+  uint8_t* GetBuffer(int buffer) const;
+
+  // @desc - queues a read into a registered buffer and submits it.
+  // @param request - tracks the read.
+  // @param fd - file to read from.
+  // @param buffer - index of the buffer.
+  // @param size - number of bytes, at most kBufferSize.
+  // @param offset - position in the file.
+  // @return bool - false if the read cannot be submitted.
+  bool QueueRead(UringRequest& request, int fd, int buffer, size_t size,
+                 uint64_t offset);
+
+  // @desc - queues a write from a registered buffer and submits it.
+  // @param request - tracks the write.
+  // @param fd - file to write to.
+  // @param buffer - index of the buffer.
+  // @param size - number of bytes, at most kBufferSize.
+  // @param offset - position in the file.
+  // @return bool - false if the write cannot be submitted.
+  bool QueueWrite(UringRequest& request, int fd, int buffer, size_t size,
+                  uint64_t offset);
+
+  // @desc - blocks until a request is done. completions of other requests
+  //         of the ring that arrive meanwhile are recorded in them. if the
+  //         kernel keeps failing the wait, the request is done with the
+  //         error and the ring takes no more requests.
+  // @param request - the request to wait for.
+  void Wait(UringRequest& request);
+
+private:
+  struct Ring;
+  std::unique_ptr<Ring> ring_;
+  uint8_t* buffers_ = nullptr;
+  // bit i is set if buffer i is taken.
+  unsigned int taken_buffers_ = 0;
+  // number of submitted requests which are not reaped yet.
+  unsigned int in_flight_ = 0;
+  // true once waiting on the ring failed for good. nothing is reaped or
+  // submitted any more.
+  bool failed_ = false;
+
+  Uring();
+
+  // @desc - creates the ring and registers the buffers.
+  // @return bool - false if io_uring is not available.
+  bool Setup();
+
+  // @desc - fills a submission queue entry and submits it.
+  bool Queue(uint8_t opcode, UringRequest& request, int fd, int buffer,
+             size_t size, uint64_t offset);
+
+  // @desc - moves completions from the completion queue to their requests.
+  void Reap();
+};
+
+#endif // WASHMYWAVES_IO_URING_H__
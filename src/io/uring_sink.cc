@@ -0,0 +1,117 @@
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#include "io/uring_sink.hh"
+
+std::unique_ptr<UringSink> UringSink::Open(
+    const std::filesystem::path& file_name) {
+  auto ring = Uring::GetThreadRing();
+  if (!ring) {
+    return nullptr;
+  }
+  // buffers are taken before the file is created, so a sink that cannot
+  // get them leaves the file to the stream sink that takes over.
+  std::unique_ptr<UringSink> sink(new UringSink(*ring));
+  if (sink->number_of_slots_ < kWriteBehind) {
+    return nullptr;
+  }
+  sink->fd_ = open(file_name.c_str(),
+                   O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (sink->fd_ < 0) {
+    return nullptr;
+  }
+  return sink;
+}
+
+UringSink::UringSink(Uring& ring) : ring_(ring) {
+  for (auto& slot : slots_) {
+    slot.buffer = ring_.AcquireBuffer();
+    if (slot.buffer < 0) {
+      break;
+    }
+    number_of_slots_++;
+  }
+}
+
+UringSink::~UringSink() {
+  Close();
+  for (int i = 0; i < number_of_slots_; i++) {
+    auto& slot = slots_[i];
+    ring_.ReleaseBuffer(slot.buffer);
+  }
+}
+
+bool UringSink::Write(const void* data, size_t size) {
+  auto bytes = (const uint8_t*)data;
+  while (size > 0 && !failed_) {
+    auto& slot = slots_[current_slot_];
+    auto bytes_to_copy = std::min(size, Uring::kBufferSize - slot.size);
+    memcpy(ring_.GetBuffer(slot.buffer) + slot.size, bytes, bytes_to_copy);
+    slot.size += bytes_to_copy;
+    bytes += bytes_to_copy;
+    size -= bytes_to_copy;
+    if (slot.size == Uring::kBufferSize) {
+      Flush();
+    }
+  }
+  return !failed_;
+}
+
+bool UringSink::Close() {
+  if (fd_ < 0) {
+    return !failed_;
+  }
+  if (slots_[current_slot_].size > 0) {
+    Flush();
+  }
+  for (int i = 0; i < number_of_slots_; i++) {
+    auto& slot = slots_[i];
+    Wait(slot);
+  }
+  if (close(fd_) != 0) {
+    failed_ = true;
+  }
+  fd_ = -1;
+  return !failed_;
+}
+
+void UringSink::Flush() {
+  auto& slot = slots_[current_slot_];
+  slot.offset = offset_;
+  offset_ += slot.size;
+  if (!ring_.QueueWrite(slot.request, fd_, slot.buffer, slot.size,
+                        slot.offset)) {
+    failed_ = true;
+  }
+
+  // the next buffer is filled while this one is written.
+  current_slot_ = (current_slot_ + 1) % number_of_slots_;
+  Wait(slots_[current_slot_]);
+}
+
+void UringSink::Wait(Slot& slot) {
+  if (!slot.request.done) {
+    ring_.Wait(slot.request);
+    auto written = slot.request.result;
+    if (written >= 0 && (size_t)written < slot.size) {
+      // short writes are finished the blocking way.
+      auto data = ring_.GetBuffer(slot.buffer);
+      while ((size_t)written < slot.size) {
+        auto bytes = pwrite(fd_, data + written, slot.size - written,
+                            slot.offset + written);
+        if (bytes <= 0) {
+          break;
+        }
+        written += bytes;
+      }
+    }
+    if (written < 0 || (size_t)written != slot.size) {
+      failed_ = true;
+    }
+  }
+  slot.size = 0;
+}
+#endif // __linux__
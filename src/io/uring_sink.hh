@@ -0,0 +1,62 @@
+#ifndef WASHMYWAVES_IO_URING_SINK_H__
+#define WASHMYWAVES_IO_URING_SINK_H__
+#include <memory>
+
+#include "io/sink.hh"
+#include "io/uring.hh"
+
+// UringSink writes a file through the io_uring of the current thread. data
+// is gathered in a registered buffer, and a full buffer is written in the
+// background while the next one fills up.
+class UringSink : public Sink {
+public:
+  // @desc - creates a file for writing with io_uring.
+  // @param file_name - path to the file, it is created or truncated.
+  // @return std::unique_ptr<UringSink> - the sink, nullptr if io_uring or
+  //         enough free buffers are not available, or on error.
+  static std::unique_ptr<UringSink> Open(
+      const std::filesystem::path& file_name);
+
+  ~UringSink();
+
+  UringSink(const UringSink&) = delete;
+  UringSink& operator=(const UringSink&) = delete;
+
+  bool Write(const void* data, size_t size) override;
+  bool Close() override;
+
+private:
+  // number of registered buffers each sink writes from.
+  static constexpr int kWriteBehind = 2;
+
+  // a registered buffer and the write from it.
+  struct Slot {
+    int buffer;
+    UringRequest request;
+    size_t size = 0;
+    uint64_t offset = 0;
+  };
+
+  Uring& ring_;
+  // -1 until the file is created.
+  int fd_ = -1;
+  Slot slots_[kWriteBehind];
+  // number of slots that got a buffer.
+  int number_of_slots_ = 0;
+  // slot being filled.
+  size_t current_slot_ = 0;
+  // position in the file of the next write.
+  uint64_t offset_ = 0;
+  bool failed_ = false;
+
+  explicit UringSink(Uring& ring);
+
+  // @desc - queues the write of the slot being filled and moves to the next
+  //         one, waiting for its previous write.
+  void Flush();
+
+  // @desc - waits for the write of a slot and checks its result.
+  void Wait(Slot& slot);
+};
+
+#endif // WASHMYWAVES_IO_URING_SINK_H__
@@ -0,0 +1,194 @@
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#include "io/uring_source.hh"
+
+std::unique_ptr<UringSource> UringSource::Open(
+    const std::filesystem::path& file_name) {
+  auto ring = Uring::GetThreadRing();
+  if (!ring) {
+    return nullptr;
+  }
+
+  // pipes and other special files are checked before opening them, like in
+  // MappedSource.
+  struct stat file_stat;
+  if (stat(file_name.c_str(), &file_stat) != 0 ||
+      !S_ISREG(file_stat.st_mode)) {
+    return nullptr;
+  }
+  int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+    close(fd);
+    return nullptr;
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  std::unique_ptr<UringSource> source(
+      new UringSource(*ring, fd, file_stat.st_size));
+  // at least two buffers are needed to read ahead while the caller uses one.
+  if (source->number_of_slots_ < 2) {
+    return nullptr;
+  }
+  return source;
+}
+
+UringSource::UringSource(Uring& ring, int fd, uint64_t size)
+    : ring_(ring), fd_(fd), size_(size) {
+  for (auto& slot : slots_) {
+    slot.buffer = ring_.AcquireBuffer();
+    if (slot.buffer < 0) {
+      break;
+    }
+    number_of_slots_++;
+  }
+}
+
+UringSource::~UringSource() {
+  DropSlots();
+  for (int i = 0; i < number_of_slots_; i++) {
+    auto& slot = slots_[i];
+    ring_.ReleaseBuffer(slot.buffer);
+  }
+  close(fd_);
+}
+
+size_t UringSource::Read(void* buffer, size_t size) {
+  size_t bytes_read = 0;
+  while (bytes_read < size) {
+    const uint8_t* data;
+    auto bytes = Fetch(std::min(size - bytes_read, Uring::kBufferSize),
+                       &data);
+    if (bytes == 0) {
+      break;
+    }
+    memcpy((uint8_t*)buffer + bytes_read, data, bytes);
+    bytes_read += bytes;
+  }
+  return bytes_read;
+}
+
+size_t UringSource::Fetch(size_t size, const uint8_t** data) {
+  size = (size_t)std::min<uint64_t>(size, size_ - position_);
+  current_slot_ = -1;
+  if (size == 0) {
+    return 0;
+  }
+
+  if (size > Uring::kBufferSize) {
+    // too large for a registered buffer, read it the blocking way.
+    buffer_.resize(size);
+    size_t bytes_read = 0;
+    while (bytes_read < size) {
+      auto bytes = pread(fd_, buffer_.data() + bytes_read, size - bytes_read,
+                         position_ + bytes_read);
+      if (bytes <= 0) {
+        break;
+      }
+      bytes_read += bytes;
+    }
+    *data = buffer_.data();
+    position_ += bytes_read;
+    return bytes_read;
+  }
+
+  read_size_ = std::max(size, kMinReadSize);
+  auto slot = FindSlot(position_, size);
+  if (slot < 0) {
+    // the caller jumped or changed the size of its reads, the reads ahead
+    // start over from here.
+    DropSlots();
+    next_offset_ = position_;
+    ReadAhead();
+    slot = FindSlot(position_, size);
+  }
+  if (slot < 0) {
+    // the read failed or came back short.
+    return 0;
+  }
+
+  current_slot_ = slot;
+  *data = ring_.GetBuffer(slots_[slot].buffer) +
+          (position_ - slots_[slot].offset);
+  position_ += size;
+  ReadAhead();
+  return size;
+}
+
+bool UringSource::Seek(uint64_t offset) {
+  if (offset > size_) {
+    return false;
+  }
+  // reads ahead are kept, the next fetch decides if they are still useful.
+  position_ = offset;
+  current_slot_ = -1;
+  return true;
+}
+
+uint64_t UringSource::Tell() const {
+  return position_;
+}
+
+uint64_t UringSource::GetSize() const {
+  return size_;
+}
+
+int UringSource::FindSlot(uint64_t offset, size_t size) {
+  for (int i = 0; i < number_of_slots_; i++) {
+    auto& slot = slots_[i];
+    if (slot.queued && slot.offset <= offset &&
+        offset + size <= slot.offset + slot.size) {
+      ring_.Wait(slot.request);
+      if (slot.request.result < 0 ||
+          offset + size > slot.offset + slot.request.result) {
+        return -1;
+      }
+      return i;
+    }
+  }
+  return -1;
+}
+
+void UringSource::DropSlots() {
+  for (int i = 0; i < number_of_slots_; i++) {
+    auto& slot = slots_[i];
+    if (slot.queued) {
+      ring_.Wait(slot.request);
+      slot.queued = false;
+    }
+  }
+}
+
+void UringSource::ReadAhead() {
+  for (int i = 0; i < number_of_slots_; i++) {
+    auto& slot = slots_[i];
+    // slots which are entirely behind the position are free.
+    if (i == current_slot_ ||
+        (slot.queued && slot.offset + slot.size > position_)) {
+      continue;
+    }
+    if (slot.queued) {
+      ring_.Wait(slot.request);
+      slot.queued = false;
+    }
+    if (next_offset_ >= size_) {
+      continue;
+    }
+    slot.offset = next_offset_;
+    slot.size = (size_t)std::min<uint64_t>(read_size_, size_ - next_offset_);
+    if (!ring_.QueueRead(slot.request, fd_, slot.buffer, slot.size,
+                         slot.offset)) {
+      return;
+    }
+    slot.queued = true;
+    next_offset_ += slot.size;
+  }
+}
+#endif // __linux__
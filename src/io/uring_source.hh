@@ -0,0 +1,80 @@
+#ifndef WASHMYWAVES_IO_URING_SOURCE_H__
+#define WASHMYWAVES_IO_URING_SOURCE_H__
+#include <memory>
+#include <vector>
+
+#include "io/source.hh"
+#include "io/uring.hh"
+
+// UringSource reads a file through the io_uring of the current thread. it
+// keeps several reads in flight ahead of the caller, each into a registered
+// buffer, and Fetch() returns pointers into those buffers. reads ahead are
+// as large as the last fetch, so a reader that fetches equal spans, like
+// WavHeader, gets every span from a single read without copying it.
+class UringSource : public Source {
+public:
+  // @desc - opens a regular file for reading with io_uring.
+  // @param file_name - path to the file.
+  // @return std::unique_ptr<UringSource> - the source, nullptr if io_uring
+  //         or enough free buffers are not available, or the file is not a
+  //         regular file.
+  static std::unique_ptr<UringSource> Open(
+      const std::filesystem::path& file_name);
+
+  ~UringSource();
+
+  UringSource(const UringSource&) = delete;
+  UringSource& operator=(const UringSource&) = delete;
+
+  size_t Read(void* buffer, size_t size) override;
+  size_t Fetch(size_t size, const uint8_t** data) override;
+  bool Seek(uint64_t offset) override;
+  uint64_t Tell() const override;
+  uint64_t GetSize() const override;
+
+private:
+  // number of registered buffers each source reads into.
+  static constexpr int kReadAhead = 4;
+  // reads are never smaller than this, so parsing small chunks does not
+  // cost a read each.
+  static constexpr size_t kMinReadSize = 64 * 1024;
+
+  // a registered buffer and the read into it.
+  struct Slot {
+    int buffer;
+    UringRequest request;
+    bool queued = false;
+    uint64_t offset = 0;
+    size_t size = 0;
+  };
+
+  Uring& ring_;
+  int fd_;
+  uint64_t size_;
+  uint64_t position_ = 0;
+  Slot slots_[kReadAhead];
+  // number of slots that got a buffer.
+  int number_of_slots_ = 0;
+  // slot that holds the memory returned by the last Fetch(), it is not
+  // reused before the next call.
+  int current_slot_ = -1;
+  // position and size of the next read ahead.
+  uint64_t next_offset_ = 0;
+  size_t read_size_ = kMinReadSize;
+  // fetches larger than a registered buffer are copied here.
+  std::vector<uint8_t> buffer_;
+
+  UringSource(Uring& ring, int fd, uint64_t size);
+
+  // @desc - finds the slot whose read covers a range, and waits for it.
+  // @return int - index of the slot, -1 if no read covers the range.
+  int FindSlot(uint64_t offset, size_t size);
+
+  // @desc - waits for every read in flight and forgets them.
+  void DropSlots();
+
+  // @desc - queues reads ahead into every slot that is free.
+  void ReadAhead();
+};
+
+#endif // WASHMYWAVES_IO_URING_SOURCE_H__
@@ -1,76 +1,324 @@
+#include <getopt.h>
+#include <unistd.h>
 #include <filesystem>
-#include <algorithm>
-#include <pthread.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
 #include <vector>
+#include "io/directory_scanner.hh"
+#include "io/directory_watcher.hh"
+#include "io/path_list.hh"
+#include "io/sink.hh"
+#include "io/stream_source.hh"
+#include "utils/global.hh"
+#include "utils/metrics.hh"
+#include "utils/report.hh"
+#include "utils/shard.hh"
+#include "utils/worker_pool.hh"
 #include "wav/converter.hh"
-
-void* ThreadEntry(void* arg) {
-  auto path = (const std::filesystem::path*)arg;
-  ConvertWavToMP3(*path);
-  pthread_exit(NULL);
-}
+#include "wav/downmix.hh"
+#include "wav/header.hh"
 
 void PrintUsage() {
-  printf("USAGE: washmywaves wav_files_directory\n");
+  printf("USAGE: washmywaves [options] wav_files_or_directories...\n");
+  printf("       washmywaves [options] --files-from list.txt\n");
+  printf("       washmywaves [options] - < input.wav > output.mp3\n");
+  printf("  options:\n");
+  printf("    -j, --jobs N  number of worker threads, defaults to the\n");
+  printf("                  number of online cpus.\n");
+  printf("    -s, --segments N  split files longer than about a minute into\n");
+  printf("                  up to N segments which are encoded in parallel.\n");
+  printf("                  segments are encoded without the bit reservoir.\n");
+  printf("    --io BACKEND  how files are read and written, \"blocking\"\n");
+  printf("                  (default) or \"uring\". uring falls back to\n");
+  printf("                  blocking if io_uring is not available. each\n");
+  printf("                  job reads one file at a time, so the reads in\n");
+  printf("                  flight grow with -j, not with the files.\n");
+  printf("    --reuse-encoders  reuse initialized encoders for files of the\n");
+  printf("                  same format. faster for short files, but the\n");
+  printf("                  output differs from a run without it, even\n");
+  printf("                  with one job, and between runs with more jobs.\n");
+  printf("    --files-from FILE  also convert the files and directories\n");
+  printf("                  listed in FILE, one per line. - reads the list\n");
+  printf("                  from stdin.\n");
+  printf("    -0, --null  entries of the list end with a nul character\n");
+  printf("                  instead of a new line, like find -print0.\n");
+  printf("    --shard I/N  convert only the files of shard I, from 0 to\n");
+  printf("                  N - 1. a file belongs to the shard picked by a\n");
+  printf("                  hash of its path below the directory it is\n");
+  printf("                  found in, or of its path as given if it is\n");
+  printf("                  given by itself. N instances given the same\n");
+  printf("                  trees, even mounted elsewhere, convert every\n");
+  printf("                  file exactly once.\n");
+  printf("    --downmix MIX  how files with more than 2 channels are\n");
+  printf("                  mixed down. \"stereo\" (default) and \"mono\"\n");
+  printf("                  use the standard matrix of their speakers,\n");
+  printf("                  mono also mixes stereo files. a matrix like\n");
+  printf("                  \"1,0,0.7;0,1,0.7\" gives the gains of each\n");
+  printf("                  input channel, one row per output channel, for\n");
+  printf("                  files with that many channels.\n");
+  printf("    -w, --watch  keep running and convert every wav file that is\n");
+  printf("                  written or moved into the directory, as soon as\n");
+  printf("                  it is closed. stops on SIGINT or SIGTERM.\n");
+  printf("    --report FILE  write a json record of the timings of every\n");
+  printf("                  file and a summary of the batch to FILE.\n");
+  printf("    --metrics-file FILE  write live metrics in the prometheus\n");
+  printf("                  text format to FILE, renamed over it.\n");
+  printf("    --metrics-socket PATH  serve live metrics to every client\n");
+  printf("                  that connects to the unix socket PATH.\n");
+  printf("    --metrics-interval N  seconds between writes of the metrics\n");
+  printf("                  file, 10 by default.\n");
+  printf("  .wav files are searched in all subdirectories. with -, a wav\n");
+  printf("  stream is read from stdin and mp3 is written to stdout, status\n");
+  printf("  lines go to stderr.\n");
   printf("  supported wav files:\n");
   printf("    - All types of PCM formats within 8-bits and 32-bits.\n");
-  printf("    - IEEE float formats.\n");
+  printf("    - IEEE float formats, 32 and 64-bits.\n");
+  printf("    - G.711 a-law and mu-law.\n");
+  printf("    - RF64 and BW64 files larger than 4GiB.\n");
+  printf("    - Up to 32 channels, mixed down to stereo or mono.\n");
 }
 
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
+#ifdef DEBUG
+  // debug builds check the parts that a batch of files does not exercise
+  // on its own.
+  if (!ValidateWorkerPool()) {
+    PRINTF("worker pool does not run every task exactly once.\n");
+    return 1;
+  }
+  if (!ValidateShards()) {
+    PRINTF("shards are not parsed or hashed as expected.\n");
+    return 1;
+  }
+  if (!ValidateDownmixMatrices()) {
+    PRINTF("downmix matrices are not built or parsed as expected.\n");
+    return 1;
+  }
+  if (!ValidateWavHeaders()) {
+    PRINTF("wav headers are not parsed as expected.\n");
+    return 1;
+  }
+#endif
+  unsigned int number_of_jobs = 0;
+  ConvertOptions options;
+  bool watch = false;
+  const char* list_path = nullptr;
+  char list_separator = '\n';
+  Shard shard;
+  const char* report_path = nullptr;
+  const char* metrics_path = "";
+  const char* metrics_socket_path = "";
+  unsigned int metrics_interval = 10;
+
+  const struct option long_options[] = {
+    {"jobs", required_argument, nullptr, 'j'},
+    {"segments", required_argument, nullptr, 's'},
+    {"io", required_argument, nullptr, 'i'},
+    {"reuse-encoders", no_argument, nullptr, 'r'},
+    {"watch", no_argument, nullptr, 'w'},
+    {"files-from", required_argument, nullptr, 'F'},
+    {"null", no_argument, nullptr, '0'},
+    {"shard", required_argument, nullptr, 'S'},
+    {"downmix", required_argument, nullptr, 'D'},
+    {"report", required_argument, nullptr, 'R'},
+    {"metrics-file", required_argument, nullptr, 'M'},
+    {"metrics-socket", required_argument, nullptr, 'U'},
+    {"metrics-interval", required_argument, nullptr, 'I'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "j:s:w0h", long_options, nullptr)) !=
+         -1) {
+    switch (option) {
+      case 'j': {
+        char* end = nullptr;
+        auto value = strtol(optarg, &end, 10);
+        if (*end != '\0' || value <= 0) {
+          printf("invalid number of jobs: %s\n", optarg);
+          return 1;
+        }
+        number_of_jobs = value;
+        break;
+      }
+      case 's': {
+        char* end = nullptr;
+        auto value = strtol(optarg, &end, 10);
+        if (*end != '\0' || value <= 0) {
+          printf("invalid number of segments: %s\n", optarg);
+          return 1;
+        }
+        options.segments = value;
+        break;
+      }
+      case 'i':
+        if (strcmp(optarg, "blocking") == 0) {
+          options.io_backend = IOBackend::kBlocking;
+        } else if (strcmp(optarg, "uring") == 0) {
+          options.io_backend = IOBackend::kUring;
+        } else {
+          printf("invalid io backend: %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'r':
+        options.reuse_encoders = true;
+        break;
+      case 'w':
+        watch = true;
+        break;
+      case 'F':
+        list_path = optarg;
+        break;
+      case '0':
+        list_separator = '\0';
+        break;
+      case 'S':
+        if (!ParseShard(optarg, shard)) {
+          printf("invalid shard: %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'D':
+        if (strcmp(optarg, "stereo") == 0) {
+          options.downmix.output_channels = 2;
+        } else if (strcmp(optarg, "mono") == 0) {
+          options.downmix.output_channels = 1;
+        } else if (!ParseDownmixMatrix(optarg, options.downmix.matrix)) {
+          printf("invalid downmix: %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'R':
+        report_path = optarg;
+        break;
+      case 'M':
+        metrics_path = optarg;
+        break;
+      case 'U':
+        metrics_socket_path = optarg;
+        break;
+      case 'I': {
+        char* end = nullptr;
+        auto value = strtol(optarg, &end, 10);
+        if (*end != '\0' || value <= 0) {
+          printf("invalid metrics interval: %s\n", optarg);
+          return 1;
+        }
+        metrics_interval = value;
+        break;
+      }
+      default:
+        PrintUsage();
+        return 1;
+    }
+  }
+  if (optind == argc && !list_path) {
     PrintUsage();
     return 1;
   }
 
-  std::vector<pthread_t> threads;
-  std::vector<std::filesystem::path*> wav_files;
+  // mp3 data of a stream goes to stdout, so everything printed goes to
+  // stderr from here on.
+  bool streaming = optind == argc - 1 && strcmp(argv[optind], "-") == 0;
+  int mp3_fd = -1;
+  if (streaming) {
+    mp3_fd = dup(STDOUT_FILENO);
+    if (mp3_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+      fprintf(stderr, "cannot redirect stdout.\n");
+      return 1;
+    }
+    if (watch) {
+      printf("cannot watch a stream.\n");
+      return 1;
+    }
+    if (list_path) {
+      printf("cannot read a list of paths with a stream.\n");
+      return 1;
+    }
+  }
 
-  // check if the input parameter is a valid path to directory.
-  auto wav_dir = std::filesystem::path(argv[1]);
-  if (!std::filesystem::is_directory(wav_dir)) {
-    printf("cannot open %s.\n", argv[1]);
+  // check if the input parameters are valid paths to files or directories.
+  std::vector<std::filesystem::path> wav_paths;
+  for (int i = optind; !streaming && i < argc; i++) {
+    std::error_code error;
+    if (!std::filesystem::exists(argv[i], error)) {
+      printf("cannot open %s.\n", argv[i]);
+      return 1;
+    }
+    wav_paths.emplace_back(argv[i]);
+  }
+  if (watch && (list_path || wav_paths.size() != 1 ||
+                !std::filesystem::is_directory(wav_paths[0]))) {
+    printf("can only watch a single directory.\n");
     return 1;
   }
 
-  // directory_iterator, introduced in C++17, is platform independant.
-  // we do not need to worry about compilation in windows/linux.
-  for (const auto &file : std::filesystem::directory_iterator(wav_dir)) {
-    if (file.path().has_extension()) { 
-      auto extention = std::string(file.path().extension());
-      // make extention lowercase.
-      // TODO: we are assuming that file paths are ascii. this is a very
-      // dangerous assumption.
-      std::transform(extention.begin(), extention.end(), extention.begin(),
-        [](unsigned char c) { return std::tolower(c); });
-      if (extention == ".wav") {
-        // parameters to threads are passed by reference. that's why we need
-        // to store each path in a new variable and pass it to threads.
-        wav_files.push_back(new std::filesystem::path(file.path()));
-        // creating threads
-        // for each wav file, we create a separate thread. we do not care how
-        // many cores exist on the cpu and let the kernel handle multitasking.
-        // if there are enough cores available, each thread will be run on a 
-        // separate core.
-        pthread_t new_thread;
-        auto result = pthread_create(
-            &new_thread,
-            NULL,
-            ThreadEntry,
-            (void*) wav_files[wav_files.size()-1]);
-        if (result) {
-          // we really do not care about threads but we store them here anyway.
-          threads.push_back(new_thread);
-        }
-      }
+  if (watch) {
+    // every thread started from here on leaves the stop signals to the
+    // watch, so the queued files are finished before exiting. the log is
+    // flushed line by line, it is likely to be redirected to a file.
+    BlockStopSignals();
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+  }
+
+  std::unique_ptr<Report> report;
+  if (report_path) {
+    report = std::make_unique<Report>(report_path);
+    if (!report->IsOpen()) {
+      printf("cannot create %s.\n", report_path);
+      return 1;
     }
+    options.report = report.get();
   }
 
-  pthread_exit(NULL);
+  std::unique_ptr<MetricsExporter> exporter;
+  if (*metrics_path || *metrics_socket_path) {
+    exporter = std::make_unique<MetricsExporter>(
+        metrics_path, metrics_socket_path, metrics_interval);
+    if (!exporter->IsRunning()) {
+      return 1;
+    }
+  }
 
-  // freeing file paths, as they are allocated on heap.
-  for (auto file : wav_files) {
-    delete file;
+  int exit_code = 0;
+  if (streaming) {
+    // a stream is encoded in one pass on this thread.
+    StreamSource input(std::cin);
+    FileSink output(mp3_fd);
+    if (!ConvertWavStream(input, output, options)) {
+      exit_code = 1;
+    }
+  } else {
+    // files are encoded while the rest of the tree is still being scanned.
+    WorkerPool pool(number_of_jobs);
+    options.pool = &pool;
+    auto convert = [options](const std::filesystem::path& path) {
+      ConvertWavToMP3(path, options);
+    };
+    // a file given more than once, on the command line, in the list or
+    // through a directory above it, is converted once.
+    QueuedPaths queued;
+    if (watch) {
+      if (!WatchWavFiles(wav_paths[0], pool, convert, shard)) {
+        exit_code = 1;
+      }
+    } else {
+      QueueWavPaths(wav_paths, pool, convert, shard, &queued);
+      if (list_path && !QueueListedPaths(list_path, list_separator, pool,
+                                         convert, shard, &queued)) {
+        exit_code = 1;
+      }
+    }
+    pool.Join();
   }
-  return 0;
+  if (report) {
+    report->WriteSummary();
+  }
+  // writes the final metrics of the batch.
+  exporter.reset();
+
+  return exit_code;
 }
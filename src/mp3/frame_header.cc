@@ -0,0 +1,45 @@
+#include "mp3/frame_header.hh"
+
+// version field of mpeg-1 frames. 0 is mpeg-2.5, 1 is reserved and 2 is
+// mpeg-2.
+const unsigned int kMPEG1 = 3;
+
+// layer III bitrates in kbps indexed by [mpeg-1][bitrate index]. mpeg-2 and
+// mpeg-2.5 share the second row. index 0 is free format, which lame never
+// writes.
+static const unsigned int kBitrates[2][15] = {
+  {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+  {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+};
+
+// sample rates indexed by [version][sample rate index].
+static const unsigned int kSampleRates[4][3] = {
+  {11025, 12000, 8000},    // mpeg-2.5
+  {0, 0, 0},               // reserved
+  {22050, 24000, 16000},   // mpeg-2
+  {44100, 48000, 32000},   // mpeg-1
+};
+
+size_t GetMP3FrameSize(const uint8_t* header) {
+  // 11 bits of frame sync.
+  if (header[0] != 0xff || (header[1] & 0xe0) != 0xe0) {
+    return 0;
+  }
+  unsigned int version = (header[1] >> 3) & 0x03;
+  unsigned int layer = (header[1] >> 1) & 0x03;
+  unsigned int bitrate_index = header[2] >> 4;
+  unsigned int sample_rate_index = (header[2] >> 2) & 0x03;
+  unsigned int padding = (header[2] >> 1) & 0x01;
+  // layer III is 01 in the header.
+  if (version == 1 || layer != 1 || bitrate_index == 0 ||
+      bitrate_index == 15 || sample_rate_index == 3) {
+    return 0;
+  }
+
+  auto bitrate = kBitrates[version == kMPEG1 ? 0 : 1][bitrate_index] * 1000;
+  auto sample_rate = kSampleRates[version][sample_rate_index];
+  // a mpeg-1 frame holds 1152 samples, the others hold 576. a slot is one
+  // byte in layer III.
+  auto slots_per_frame = version == kMPEG1 ? 144 : 72;
+  return slots_per_frame * bitrate / sample_rate + padding;
+}
@@ -0,0 +1,17 @@
+#ifndef WASHMYWAVES_MP3_FRAME_HEADER_H__
+#define WASHMYWAVES_MP3_FRAME_HEADER_H__
+#include <cstddef>
+#include <cstdint>
+
+// size of the header at the beginning of every mp3 frame.
+const size_t kMP3FrameHeaderSize = 4;
+
+// @desc - reads the size of a mpeg audio layer III frame from its header.
+//         lame only produces layer III frames, every other layer is
+//         rejected.
+// @param header - first kMP3FrameHeaderSize bytes of the frame.
+// @return size_t - size of the whole frame including the header, 0 if the
+//         header is not a valid layer III frame header.
+size_t GetMP3FrameSize(const uint8_t* header);
+
+#endif // WASHMYWAVES_MP3_FRAME_HEADER_H__
@@ -0,0 +1,94 @@
+#include <new>
+
+#include "utils/buffer_pool.hh"
+
+// set when the pool of the thread is destroyed, buffers freed after that,
+// by other thread_local objects, go straight back to the heap.
+static thread_local bool pool_destroyed = false;
+
+BufferPool* BufferPool::GetThreadPool() {
+  static thread_local BufferPool pool;
+  if (pool_destroyed) {
+    return nullptr;
+  }
+  return &pool;
+}
+
+int BufferPool::GetClass(size_t size) {
+  int size_class = kMinClass;
+  while (size_class < kNumberOfClasses && ((size_t)1 << size_class) < size) {
+    size_class++;
+  }
+  return size_class;
+}
+
+void* BufferPool::Allocate(size_t size) {
+  auto size_class = GetClass(size);
+  if (size_class >= kNumberOfClasses) {
+    return ::operator new(size, std::align_val_t(kAlignment));
+  }
+
+  auto pool = GetThreadPool();
+  if (pool && pool->free_buffers_[size_class]) {
+    auto buffer = pool->free_buffers_[size_class];
+    pool->free_buffers_[size_class] = buffer->next;
+    pool->cached_size_ -= (size_t)1 << size_class;
+    return buffer;
+  }
+  return ::operator new((size_t)1 << size_class,
+                        std::align_val_t(kAlignment));
+}
+
+void BufferPool::Free(void* data, size_t size) {
+  if (!data) {
+    return;
+  }
+  auto size_class = GetClass(size);
+  auto pool = GetThreadPool();
+  if (size_class >= kNumberOfClasses || !pool ||
+      pool->cached_size_ + ((size_t)1 << size_class) > kMaxCachedSize) {
+    ::operator delete(data, std::align_val_t(kAlignment));
+    return;
+  }
+
+  auto buffer = (FreeBuffer*)data;
+  buffer->next = pool->free_buffers_[size_class];
+  pool->free_buffers_[size_class] = buffer;
+  pool->cached_size_ += (size_t)1 << size_class;
+}
+
+BufferPool::~BufferPool() {
+  pool_destroyed = true;
+  for (auto& buffer : free_buffers_) {
+    while (buffer) {
+      auto next = buffer->next;
+      ::operator delete(buffer, std::align_val_t(kAlignment));
+      buffer = next;
+    }
+  }
+}
+
+PooledBuffer::PooledBuffer(size_t size) {
+  Reserve(size);
+}
+
+PooledBuffer::~PooledBuffer() {
+  BufferPool::Free(data_, size_);
+}
+
+void PooledBuffer::Reserve(size_t size) {
+  if (size <= size_) {
+    return;
+  }
+  BufferPool::Free(data_, size_);
+  data_ = (uint8_t*)BufferPool::Allocate(size);
+  size_ = size;
+}
+
+uint8_t* PooledBuffer::GetData() const {
+  return data_;
+}
+
+size_t PooledBuffer::GetSize() const {
+  return size_;
+}
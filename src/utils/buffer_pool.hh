@@ -0,0 +1,84 @@
+#ifndef WASHMYWAVES_UTILS_BUFFER_POOL_H__
+#define WASHMYWAVES_UTILS_BUFFER_POOL_H__
+#include <cstddef>
+#include <cstdint>
+
+// BufferPool keeps freed buffers of one thread for reuse. buffers are
+// aligned to cache lines and rounded up to powers of two, and each size
+// class is a list of free buffers, so a worker that converts files one after
+// another allocates each of its buffers only for the first file.
+class BufferPool {
+public:
+  // alignment of every buffer, enough for any vector load.
+  static const size_t kAlignment = 64;
+
+  // @desc - takes a buffer from the pool of the current thread, or
+  //         allocates it if the pool has none of its size.
+  // @param size - size of the buffer in bytes.
+  // @return void* - the buffer, aligned to kAlignment.
+  static void* Allocate(size_t size);
+
+  // @desc - gives a buffer to the pool of the current thread. it can be a
+  //         buffer allocated by another thread.
+  // @param data - the buffer, nullptr is ignored.
+  // @param size - size passed to Allocate().
+  static void Free(void* data, size_t size);
+
+  ~BufferPool();
+
+private:
+  // buffers larger than 1 << (kNumberOfClasses - 1) are not pooled.
+  static const int kNumberOfClasses = 28;
+  // the smallest class holds kAlignment bytes.
+  static const int kMinClass = 6;
+  // memory kept by a pool. buffers freed beyond it go back to the heap.
+  static const size_t kMaxCachedSize = 64 << 20;
+
+  // a free buffer, the link is stored in the buffer itself.
+  struct FreeBuffer {
+    FreeBuffer* next;
+  };
+
+  FreeBuffer* free_buffers_[kNumberOfClasses] = {};
+  size_t cached_size_ = 0;
+
+  // @desc - returns the pool of the current thread.
+  // @return BufferPool* - nullptr while the thread is exiting and its pool
+  //         is already destroyed.
+  static BufferPool* GetThreadPool();
+
+  // @desc - returns the size class of a buffer.
+  static int GetClass(size_t size);
+};
+
+// PooledBuffer is a buffer taken from the BufferPool, which is given back
+// when it is destroyed or resized.
+class PooledBuffer {
+public:
+  PooledBuffer() {}
+
+  // @param size - size of the buffer in bytes.
+  explicit PooledBuffer(size_t size);
+
+  ~PooledBuffer();
+
+  PooledBuffer(const PooledBuffer&) = delete;
+  PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+  // @desc - makes the buffer at least size bytes. the content is not kept
+  //         if the buffer is replaced.
+  // @param size - minimum size in bytes.
+  void Reserve(size_t size);
+
+  // @return uint8_t* - the buffer, nullptr if it is empty.
+  uint8_t* GetData() const;
+
+  // @return size_t - size of the buffer.
+  size_t GetSize() const;
+
+private:
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+#endif // WASHMYWAVES_UTILS_BUFFER_POOL_H__
@@ -1,4 +1,6 @@
 #include <cstdio>
+#include <cstdlib>
+#include <new>
 
 #include "utils/global.hh"
 
@@ -30,6 +32,50 @@ void HEX_DUMP(const unsigned char* buffer, size_t size) {
   }
   return;
 }
+
+// heap allocations of the current thread, counted by the replaced operator
+// new below.
+static thread_local uint64_t allocations = 0;
+
+uint64_t GET_ALLOCATIONS() {
+  return allocations;
+}
+
+void* operator new(size_t size) {
+  allocations++;
+  auto data = malloc(size ? size : 1);
+  if (!data) {
+    throw std::bad_alloc();
+  }
+  return data;
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+  allocations++;
+  // aligned_alloc needs a size which is a multiple of the alignment.
+  auto align = (size_t)alignment;
+  auto data = aligned_alloc(align, (size + align - 1) / align * align);
+  if (!data) {
+    throw std::bad_alloc();
+  }
+  return data;
+}
+
+void operator delete(void* data) noexcept {
+  free(data);
+}
+
+void operator delete(void* data, size_t) noexcept {
+  free(data);
+}
+
+void operator delete(void* data, std::align_val_t) noexcept {
+  free(data);
+}
+
+void operator delete(void* data, size_t, std::align_val_t) noexcept {
+  free(data);
+}
 #endif
 
 size_t GetFileSize(std::ifstream& file) {
@@ -21,6 +21,15 @@ void HEX_DUMP(const unsigned char* buffer, size_t size);
   #define PRINTF(...) // do nothing in release builds
 #endif
 
+#ifdef DEBUG
+// @desc - returns number of heap allocations made through operator new by
+//         the current thread. used to check that converting a file does not
+//         allocate once the buffers of a worker are warmed up.
+uint64_t GET_ALLOCATIONS();
+#else
+#define GET_ALLOCATIONS() 0 // not counted in release builds
+#endif
+
 
 size_t GetFileSize(std::ifstream& file);
 
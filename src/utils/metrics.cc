@@ -0,0 +1,259 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "utils/metrics.hh"
+
+void Histogram::Observe(uint64_t value) {
+  // the smallest bucket whose bound is not below value, bucket i holds
+  // values up to first_bound_ << i.
+  uint64_t quotient = value ? (value - 1) / first_bound_ : 0;
+  unsigned int bucket = quotient ? 64 - __builtin_clzll(quotient) : 0;
+  if (bucket >= kNumberOfBuckets) {
+    bucket = kNumberOfBuckets - 1;
+  }
+  buckets_[bucket].Add();
+  sum_.Add(value);
+}
+
+Metrics& GetMetrics() {
+  static Metrics metrics;
+  return metrics;
+}
+
+// @desc - appends a formatted line to a string.
+static void Append(std::string& text, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void Append(std::string& text, const char* format, ...) {
+  char line[256];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  text += line;
+}
+
+// @desc - appends a counter or a gauge with its help and type lines.
+static void AppendMetric(std::string& text, const char* name,
+                         const char* type, const char* help, double value) {
+  Append(text, "# HELP washmywaves_%s %s\n", name, help);
+  Append(text, "# TYPE washmywaves_%s %s\n", name, type);
+  Append(text, "washmywaves_%s %.17g\n", name, value);
+}
+
+// @desc - appends a histogram. prometheus buckets are cumulative and the
+//         values are scaled to the base unit of the metric.
+static void AppendHistogram(std::string& text, const char* name,
+                            const char* help, const Histogram& histogram,
+                            double scale) {
+  Append(text, "# HELP washmywaves_%s %s\n", name, help);
+  Append(text, "# TYPE washmywaves_%s histogram\n", name);
+  uint64_t count = 0;
+  for (unsigned int i = 0; i < Histogram::kNumberOfBuckets; ++i) {
+    count += histogram.GetCount(i);
+    if (i + 1 < Histogram::kNumberOfBuckets) {
+      Append(text, "washmywaves_%s_bucket{le=\"%.17g\"} %" PRIu64 "\n", name,
+             histogram.GetBound(i) * scale, count);
+    } else {
+      Append(text, "washmywaves_%s_bucket{le=\"+Inf\"} %" PRIu64 "\n", name,
+             count);
+    }
+  }
+  Append(text, "washmywaves_%s_sum %.17g\n", name,
+         histogram.GetSum() * scale);
+  Append(text, "washmywaves_%s_count %" PRIu64 "\n", name, count);
+}
+
+std::string FormatMetrics(const Metrics& metrics) {
+  std::string text;
+  AppendMetric(text, "files_found_total", "counter",
+               "Wav files found by the directory scan.",
+               metrics.files_found.Get());
+  AppendMetric(text, "files_started_total", "counter",
+               "Conversions started.", metrics.files_started.Get());
+  AppendMetric(text, "files_converted_total", "counter",
+               "Files converted to mp3.", metrics.files_converted.Get());
+  AppendMetric(text, "files_failed_total", "counter",
+               "Files that could not be converted.",
+               metrics.files_failed.Get());
+  // counters are read one by one, a file found after files_found was read
+  // must not make the difference negative.
+  auto started = metrics.files_started.Get();
+  auto found = metrics.files_found.Get();
+  AppendMetric(text, "files_queued", "gauge",
+               "Files found and not started yet.",
+               found > started ? found - started : 0);
+  AppendMetric(text, "files_active", "gauge",
+               "Files being converted.", metrics.files_active.Get());
+  AppendMetric(text, "input_bytes_total", "counter",
+               "Pcm data read from wav files.", metrics.input_bytes.Get());
+  AppendMetric(text, "output_bytes_total", "counter",
+               "Mp3 data produced by lame.", metrics.output_bytes.Get());
+  AppendMetric(text, "frames_encoded_total", "counter",
+               "Pcm frames encoded.", metrics.frames_encoded.Get());
+  AppendMetric(text, "tasks_queued", "gauge",
+               "Tasks queued on the worker pool.", metrics.tasks_queued.Get());
+  AppendMetric(text, "workers_busy", "gauge",
+               "Worker threads running a task.", metrics.workers_busy.Get());
+  AppendMetric(text, "workers", "gauge", "Worker threads.",
+               metrics.workers.Get());
+  AppendHistogram(text, "file_duration_seconds",
+                  "Wall time of converting a file.", metrics.file_duration,
+                  1e-6);
+  AppendHistogram(text, "file_size_bytes", "Size of converted wav files.",
+                  metrics.file_size, 1);
+  return text;
+}
+
+MetricsExporter::MetricsExporter(const std::filesystem::path& textfile,
+                                 const std::filesystem::path& socket_path,
+                                 unsigned int interval)
+    : textfile_(textfile), socket_path_(socket_path),
+      interval_(interval ? interval : 1) {
+  if (!socket_path_.empty()) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path_.native().size() >= sizeof(address.sun_path)) {
+      printf("[ERROR] %s: socket path is too long.\n", socket_path_.c_str());
+      return;
+    }
+    std::strcpy(address.sun_path, socket_path_.c_str());
+    // a socket left behind by an earlier run is replaced, anything else at
+    // the path is not touched.
+    struct stat status;
+    if (lstat(socket_path_.c_str(), &status) == 0 &&
+        S_ISSOCK(status.st_mode)) {
+      unlink(socket_path_.c_str());
+    }
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        0);
+    if (listen_fd_ < 0 ||
+        bind(listen_fd_, (sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listen_fd_, 16) != 0) {
+      printf("[ERROR] %s: cannot listen: %s\n", socket_path_.c_str(),
+             strerror(errno));
+      if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+      }
+      return;
+    }
+  }
+
+  if (pipe2(stop_fds_, O_CLOEXEC) != 0) {
+    return;
+  }
+  running_ = pthread_create(&thread_, NULL, ThreadEntry, this) == 0;
+}
+
+MetricsExporter::~MetricsExporter() {
+  if (running_) {
+    char stop = 0;
+    while (write(stop_fds_[1], &stop, 1) < 0 && errno == EINTR) {
+    }
+    pthread_join(thread_, NULL);
+  }
+  for (auto fd : stop_fds_) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    unlink(socket_path_.c_str());
+  }
+}
+
+bool MetricsExporter::IsRunning() const {
+  return running_;
+}
+
+void* MetricsExporter::ThreadEntry(void* arg) {
+  ((MetricsExporter*)arg)->Run();
+  return NULL;
+}
+
+void MetricsExporter::Run() {
+  typedef std::chrono::steady_clock Clock;
+  auto next_write = Clock::now();
+  while (true) {
+    if (!textfile_.empty() && Clock::now() >= next_write) {
+      WriteTextfile();
+      next_write = Clock::now() + std::chrono::seconds(interval_);
+    }
+
+    pollfd fds[2] = {{stop_fds_[0], POLLIN, 0}, {listen_fd_, POLLIN, 0}};
+    auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+        next_write - Clock::now()).count();
+    auto ready = poll(fds, listen_fd_ >= 0 ? 2 : 1,
+                      textfile_.empty() ? -1 : std::max<int>(0, timeout));
+    if (ready < 0 && errno != EINTR) {
+      break;
+    }
+    if (fds[0].revents) {
+      break;
+    }
+    if (listen_fd_ >= 0 && fds[1].revents & POLLIN) {
+      ServeClient();
+    }
+  }
+
+  // the final numbers of the batch.
+  if (!textfile_.empty()) {
+    WriteTextfile();
+  }
+}
+
+void MetricsExporter::WriteTextfile() {
+  auto text = FormatMetrics(GetMetrics());
+  auto temporary_path = textfile_;
+  temporary_path += ".tmp";
+  auto file = fopen(temporary_path.c_str(), "w");
+  if (!file) {
+    printf("[ERROR] %s: cannot write metrics: %s\n", temporary_path.c_str(),
+           strerror(errno));
+    return;
+  }
+  bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+  written = fclose(file) == 0 && written;
+  if (!written || rename(temporary_path.c_str(), textfile_.c_str()) != 0) {
+    printf("[ERROR] %s: cannot write metrics: %s\n", textfile_.c_str(),
+           strerror(errno));
+    unlink(temporary_path.c_str());
+  }
+}
+
+void MetricsExporter::ServeClient() {
+  int client = accept4(listen_fd_, NULL, NULL, SOCK_CLOEXEC);
+  if (client < 0) {
+    return;
+  }
+  // a client that does not read must not hold up the textfile for long.
+  timeval timeout = {1, 0};
+  setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  auto text = FormatMetrics(GetMetrics());
+  size_t offset = 0;
+  while (offset < text.size()) {
+    auto written = send(client, text.data() + offset, text.size() - offset,
+                        MSG_NOSIGNAL);
+    if (written <= 0) {
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    offset += written;
+  }
+  close(client);
+}
@@ -0,0 +1,167 @@
+#ifndef WASHMYWAVES_UTILS_METRICS_H__
+#define WASHMYWAVES_UTILS_METRICS_H__
+#include <pthread.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem> // for std::filesystem::path
+#include <string>
+
+// every metric sits on a cache line of its own, so workers updating
+// different metrics do not slow each other down.
+const size_t kMetricAlignment = 64;
+
+// Counter is a monotonic count. updates are relaxed atomic additions, they
+// take no lock and impose no ordering.
+class alignas(kMetricAlignment) Counter {
+public:
+  void Add(uint64_t value = 1) {
+    value_.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  uint64_t Get() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint64_t> value_{0};
+};
+
+// Gauge is a value that goes up and down.
+class alignas(kMetricAlignment) Gauge {
+public:
+  void Add(int64_t value = 1) {
+    value_.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  void Set(int64_t value) {
+    value_.store(value, std::memory_order_relaxed);
+  }
+
+  int64_t Get() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<int64_t> value_{0};
+};
+
+// Histogram counts observations in buckets with exponentially growing upper
+// bounds, a factor of 2 apart. observing a value is two relaxed additions
+// and a bit scan.
+class Histogram {
+public:
+  static const unsigned int kNumberOfBuckets = 24;
+
+  // @param first_bound - upper bound of the first bucket.
+  explicit Histogram(uint64_t first_bound) : first_bound_(first_bound) {}
+
+  // @desc - records a value.
+  void Observe(uint64_t value);
+
+  // @desc - returns upper bound of a bucket, the last one has none.
+  uint64_t GetBound(unsigned int bucket) const {
+    return first_bound_ << bucket;
+  }
+
+  // @desc - returns number of values that fell in a bucket.
+  uint64_t GetCount(unsigned int bucket) const {
+    return buckets_[bucket].Get();
+  }
+
+  // @desc - returns sum of all values.
+  uint64_t GetSum() const {
+    return sum_.Get();
+  }
+
+private:
+  uint64_t first_bound_;
+  Counter buckets_[kNumberOfBuckets];
+  Counter sum_;
+};
+
+// Metrics are the live counters of a batch. they are always kept, whether
+// they are exported or not.
+struct Metrics {
+  // wav files found by the directory scan.
+  Counter files_found;
+  // conversions started, finished with an mp3 file, and failed.
+  Counter files_started;
+  Counter files_converted;
+  Counter files_failed;
+  // pcm data read from wav files and mp3 data produced by lame, as
+  // conversions go. lead-in frames of segments are counted twice.
+  Counter input_bytes;
+  Counter output_bytes;
+  // pcm frames encoded.
+  Counter frames_encoded;
+  // files being converted at the moment.
+  Gauge files_active;
+  // tasks queued on the worker pool and not started yet.
+  Gauge tasks_queued;
+  // worker threads running a task, and all worker threads.
+  Gauge workers_busy;
+  Gauge workers;
+  // wall time of each converted file, in microseconds.
+  Histogram file_duration{1000};
+  // size of each converted wav file, in bytes.
+  Histogram file_size{16 * 1024};
+};
+
+// @desc - returns the metrics of the process.
+// @return Metrics
+Metrics& GetMetrics();
+
+// @desc - formats metrics in the prometheus text exposition format.
+// @param metrics - the metrics.
+// @return std::string
+std::string FormatMetrics(const Metrics& metrics);
+
+// MetricsExporter publishes the metrics from a thread of its own. they are
+// written to a prometheus textfile every interval, and to every client that
+// connects to a unix socket. neither touches the threads that convert files.
+class MetricsExporter {
+public:
+  // @desc - starts exporting.
+  // @param textfile - file to write, empty for none. it is written to a
+  //        temporary file next to it and renamed over it, so readers never
+  //        see a partial file.
+  // @param socket_path - unix socket to listen on, empty for none.
+  // @param interval - seconds between writes of textfile.
+  MetricsExporter(const std::filesystem::path& textfile,
+                  const std::filesystem::path& socket_path,
+                  unsigned int interval);
+
+  // @desc - writes textfile a last time and stops the thread.
+  ~MetricsExporter();
+
+  MetricsExporter(const MetricsExporter&) = delete;
+  MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+  // @desc - checks if the socket is listening and the thread is running.
+  // @return bool
+  bool IsRunning() const;
+
+private:
+  std::filesystem::path textfile_;
+  std::filesystem::path socket_path_;
+  unsigned int interval_;
+  int listen_fd_ = -1;
+  // written to by the destructor to wake the thread up.
+  int stop_fds_[2] = {-1, -1};
+  pthread_t thread_;
+  bool running_ = false;
+
+  static void* ThreadEntry(void* arg);
+
+  // @desc - main loop of the exporter thread.
+  void Run();
+
+  // @desc - writes the metrics to textfile_.
+  void WriteTextfile();
+
+  // @desc - accepts a client on the socket and sends it the metrics.
+  void ServeClient();
+};
+
+#endif // WASHMYWAVES_UTILS_METRICS_H__
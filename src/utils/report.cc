@@ -0,0 +1,185 @@
+#include <sys/resource.h>
+#include <algorithm>
+#include <cinttypes>
+#include <chrono>
+#include <cmath>
+
+#include "utils/report.hh"
+
+// @desc - writes a string as a json string literal.
+static void WriteJSONString(FILE* file, const std::string& text) {
+  fputc('"', file);
+  for (unsigned char c : text) {
+    if (c == '"' || c == '\\') {
+      fprintf(file, "\\%c", c);
+    } else if (c < 0x20) {
+      fprintf(file, "\\u%04x", c);
+    } else {
+      fputc(c, file);
+    }
+  }
+  fputc('"', file);
+}
+
+// number of buckets of each power of two of the latency histogram. times
+// below it have a bucket each.
+const uint64_t kLatencySubBuckets = 16;
+
+// @desc - returns the histogram bucket of a wall time. every power of two
+//         is split in kLatencySubBuckets, so a bucket is at most 1/16 of
+//         the times in it wide.
+// @param time - nanoseconds.
+// @return size_t - index, less than Report::kLatencyBuckets.
+static size_t GetLatencyBucket(uint64_t time) {
+  if (time < kLatencySubBuckets) {
+    return time;
+  }
+  // the 4 bits below the top one pick the sub-bucket.
+  int top_bit = 63 - __builtin_clzll(time);
+  return (top_bit - 3) * kLatencySubBuckets +
+         (time >> (top_bit - 4)) - kLatencySubBuckets;
+}
+
+// @desc - returns the middle of the wall times of a bucket.
+// @param bucket - index of the bucket.
+// @return double - nanoseconds.
+static double GetLatencyBucketTime(size_t bucket) {
+  if (bucket < kLatencySubBuckets) {
+    return bucket;
+  }
+  auto shift = bucket / kLatencySubBuckets - 1;
+  auto first = (kLatencySubBuckets + bucket % kLatencySubBuckets) << shift;
+  return first + ((1ULL << shift) - 1) / 2.0;
+}
+
+// @desc - returns a percentile of a histogram, by the nearest rank.
+// @param buckets - number of values in each bucket.
+// @param number_of_buckets - size of buckets.
+// @param number_of_values - sum of buckets.
+// @param percentile - in (0, 100].
+// @return double - 0 if there are no values.
+static double GetPercentile(const uint64_t* buckets, size_t number_of_buckets,
+                            uint64_t number_of_values, double percentile) {
+  auto rank = std::max<uint64_t>(
+      (uint64_t)ceil(percentile / 100 * number_of_values), 1);
+  uint64_t count = 0;
+  for (size_t i = 0; i < number_of_buckets; i++) {
+    count += buckets[i];
+    if (count >= rank) {
+      return GetLatencyBucketTime(i);
+    }
+  }
+  return 0;
+}
+
+// @desc - writes the stage times as milliseconds, with a leading comma.
+static void WriteStageTimes(FILE* file, const StageTimes& times) {
+  fprintf(file, ",\"parse_ms\":%.3f,\"convert_ms\":%.3f,\"encode_ms\":%.3f,"
+          "\"write_ms\":%.3f", times.parse / 1e6, times.convert / 1e6,
+          times.encode / 1e6, times.write / 1e6);
+}
+
+Report::Report(const std::filesystem::path& path)
+    : file_(fopen(path.c_str(), "w")), start_time_(GetTime()) {
+}
+
+Report::~Report() {
+  if (file_) {
+    fclose(file_);
+  }
+}
+
+bool Report::IsOpen() const {
+  return file_ != nullptr;
+}
+
+void Report::Add(const FileReport& file) {
+  double audio_seconds = file.sample_rate ?
+      (double)file.number_of_frames / file.sample_rate : 0;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_) {
+    return;
+  }
+  ++number_of_files_;
+  input_bytes_ += file.input_bytes;
+  cpu_time_ += file.cpu_time;
+  if (file.error) {
+    ++number_of_failures_;
+  } else {
+    output_bytes_ += file.output_bytes;
+    audio_seconds_ += audio_seconds;
+    times_.parse += file.times.parse;
+    times_.convert += file.times.convert;
+    times_.encode += file.times.encode;
+    times_.write += file.times.write;
+    latency_buckets_[GetLatencyBucket(file.wall_time)]++;
+  }
+
+  fprintf(file_, "{\"type\":\"file\",\"path\":");
+  WriteJSONString(file_, file.path.string());
+  if (file.error) {
+    fprintf(file_, ",\"error\":");
+    WriteJSONString(file_, file.error);
+  }
+  fprintf(file_, ",\"input_bytes\":%" PRIu64 ",\"audio_format\":%u,"
+          "\"channels\":%u,\"sample_rate\":%u,\"bits_per_sample\":%u,"
+          "\"valid_bits\":%u,\"frames\":%" PRIu64 ",\"samples\":%" PRIu64
+          ",\"segments\":%u", file.input_bytes,
+          (unsigned int)file.audio_format, file.number_of_channels,
+          file.sample_rate, file.bits_per_sample, file.valid_bits_per_sample,
+          file.number_of_frames, file.number_of_frames *
+          file.number_of_channels, file.number_of_segments);
+  WriteStageTimes(file_, file.times);
+  fprintf(file_, ",\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"realtime_factor\":%.2f,"
+          "\"output_bytes\":%" PRIu64 "}\n", file.wall_time / 1e6,
+          file.cpu_time / 1e6, file.wall_time ?
+          audio_seconds / (file.wall_time / 1e9) : 0, file.output_bytes);
+}
+
+void Report::WriteSummary() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!file_) {
+    return;
+  }
+  auto wall_seconds = (GetTime() - start_time_) / 1e9;
+  auto converted = number_of_files_ - number_of_failures_;
+
+  fprintf(file_, "{\"type\":\"batch\",\"files\":%zu,\"failed\":%zu,"
+          "\"input_bytes\":%" PRIu64 ",\"output_bytes\":%" PRIu64 ","
+          "\"audio_seconds\":%.3f,\"wall_seconds\":%.3f,\"cpu_seconds\":%.3f,"
+          "\"files_per_second\":%.2f,\"mb_per_second\":%.2f,"
+          "\"realtime_factor\":%.2f,\"latency_p50_ms\":%.3f,"
+          "\"latency_p99_ms\":%.3f", number_of_files_, number_of_failures_,
+          input_bytes_, output_bytes_, audio_seconds_, wall_seconds,
+          cpu_time_ / 1e9, converted / wall_seconds,
+          input_bytes_ / 1e6 / wall_seconds, audio_seconds_ / wall_seconds,
+          GetPercentile(latency_buckets_, kLatencyBuckets, converted, 50) /
+          1e6,
+          GetPercentile(latency_buckets_, kLatencyBuckets, converted, 99) /
+          1e6);
+  WriteStageTimes(file_, times_);
+  fprintf(file_, "}\n");
+  fflush(file_);
+}
+
+uint64_t Report::GetTime() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t Report::GetThreadCPUTime() {
+  struct rusage usage;
+#ifdef RUSAGE_THREAD
+  if (getrusage(RUSAGE_THREAD, &usage) != 0) {
+    return 0;
+  }
+#else
+  // only the cpu time of the whole process is available.
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#endif
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+}
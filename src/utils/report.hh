@@ -0,0 +1,99 @@
+#ifndef WASHMYWAVES_UTILS_REPORT_H__
+#define WASHMYWAVES_UTILS_REPORT_H__
+#include <cstdint>
+#include <cstdio>
+#include <filesystem> // for std::filesystem::path
+#include <mutex>
+#include <string>
+
+// StageTimes are the nanoseconds a conversion spends in each of its stages.
+struct StageTimes {
+  // opening the input and parsing its chunks.
+  uint64_t parse = 0;
+  // reading and converting samples for lame.
+  uint64_t convert = 0;
+  // lame encoding and flushing.
+  uint64_t encode = 0;
+  // writing mp3 data and closing the output.
+  uint64_t write = 0;
+};
+
+// FileReport is the performance record of converting one file.
+struct FileReport {
+  std::filesystem::path path;
+  // nullptr if the file is converted, the reason of the failure otherwise.
+  const char* error = nullptr;
+  uint64_t input_bytes = 0;
+  uint16_t audio_format = 0;
+  unsigned int number_of_channels = 0;
+  unsigned int sample_rate = 0;
+  unsigned int bits_per_sample = 0;
+  unsigned int valid_bits_per_sample = 0;
+  // number of frames, samples of each channel.
+  uint64_t number_of_frames = 0;
+  unsigned int number_of_segments = 1;
+  StageTimes times;
+  // from the start of the conversion to the output being closed.
+  uint64_t wall_time = 0;
+  // cpu time of all threads that worked on the file.
+  uint64_t cpu_time = 0;
+  uint64_t output_bytes = 0;
+};
+
+// Report writes a json-lines record for every converted file and a summary
+// of the whole batch. records are written as files finish, by any worker.
+class Report {
+public:
+  // @desc - creates the report file. the wall time of the batch is counted
+  //         from here.
+  // @param path - path to the report file.
+  explicit Report(const std::filesystem::path& path);
+
+  ~Report();
+
+  Report(const Report&) = delete;
+  Report& operator=(const Report&) = delete;
+
+  // @desc - checks if the report file is created.
+  // @return bool
+  bool IsOpen() const;
+
+  // @desc - writes the record of a file. it is thread-safe.
+  // @param file - the record.
+  void Add(const FileReport& file);
+
+  // @desc - writes the summary of all files added so far: throughput of the
+  //         batch and median and 99th percentile of the wall time per file,
+  //         within 1/16 of the exact ones.
+  void WriteSummary();
+
+  // @desc - returns a monotonic time.
+  // @return uint64_t - nanoseconds.
+  static uint64_t GetTime();
+
+  // @desc - returns cpu time used by the calling thread, in user and kernel
+  //         mode.
+  // @return uint64_t - nanoseconds.
+  static uint64_t GetThreadCPUTime();
+
+private:
+  FILE* file_;
+  uint64_t start_time_;
+  std::mutex mutex_;
+  // totals of the added files, guarded by mutex_.
+  size_t number_of_files_ = 0;
+  size_t number_of_failures_ = 0;
+  uint64_t input_bytes_ = 0;
+  uint64_t output_bytes_ = 0;
+  double audio_seconds_ = 0;
+  uint64_t cpu_time_ = 0;
+  StageTimes times_;
+  // number of wall time buckets, see GetLatencyBucket() in report.cc. a
+  // watcher runs for as long as it likes, so the wall times of the files are
+  // counted in a histogram rather than kept.
+  static const size_t kLatencyBuckets = 61 * 16;
+  // number of converted files in each bucket of wall time.
+  uint64_t latency_buckets_[kLatencyBuckets] = {};
+};
+
+#endif // WASHMYWAVES_UTILS_REPORT_H__
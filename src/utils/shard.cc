@@ -0,0 +1,116 @@
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "utils/shard.hh"
+
+// @desc - parses a decimal number of digits only, strtoul would also take
+//         leading spaces and signs.
+// @param text - the text to parse.
+// @param end - receives the first character after the number.
+// @param number - receives the number.
+// @return bool - false if text does not start with a digit or the number
+//         does not fit.
+static bool ParseNumber(const char* text, char** end, unsigned long& number) {
+  if (*text < '0' || *text > '9') {
+    return false;
+  }
+  errno = 0;
+  number = strtoul(text, end, 10);
+  return errno == 0 && number <= UINT_MAX;
+}
+
+bool ParseShard(const char* text, Shard& shard) {
+  char* end = nullptr;
+  unsigned long index, count;
+  if (!ParseNumber(text, &end, index) || *end != '/') {
+    return false;
+  }
+  if (!ParseNumber(end + 1, &end, count) || *end != '\0' || count == 0 ||
+      index >= count) {
+    return false;
+  }
+  shard.index = index;
+  shard.count = count;
+  return true;
+}
+
+size_t GetShardRootSize(const std::filesystem::path& root) {
+  // root / name adds a separator unless root already ends with one.
+  const auto& native = root.native();
+  if (native.empty() ||
+      native.back() == std::filesystem::path::preferred_separator) {
+    return native.size();
+  }
+  return native.size() + 1;
+}
+
+uint64_t HashPath(const char* path, size_t length) {
+  const uint64_t kOffsetBasis = 0xcbf29ce484222325ULL;
+  const uint64_t kPrime = 0x100000001b3ULL;
+  uint64_t hash = kOffsetBasis;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ (unsigned char)path[i]) * kPrime;
+  }
+  // the finalizer of splitmix64. files of a directory often differ in their
+  // last bytes only, which fnv spreads poorly.
+  hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+  return hash ^ (hash >> 31);
+}
+
+bool ValidateShards() {
+  const char* kValid[][3] = {
+    {"0/1", "0", "1"}, {"3/16", "3", "16"}, {"15/16", "15", "16"},
+    {"4294967294/4294967295", "4294967294", "4294967295"},
+  };
+  for (const auto& valid : kValid) {
+    Shard shard;
+    if (!ParseShard(valid[0], shard) ||
+        shard.index != std::stoul(valid[1]) ||
+        shard.count != std::stoul(valid[2])) {
+      return false;
+    }
+  }
+  const char* kMalformed[] = {
+    "", "3", "3/", "/16", "16/16", "17/16", "3/0", "-1/16", "3/-16", "+3/16",
+    " 3/16", "3/ 16", "3/16x", "3/16/2", "a/16", "0x3/16",
+    "3/4294967296", "3/99999999999999999999",
+  };
+  for (auto text : kMalformed) {
+    Shard shard;
+    if (ParseShard(text, shard)) {
+      return false;
+    }
+  }
+
+  if (GetShardRootSize("") != 0 || GetShardRootSize("music") != 6 ||
+      GetShardRootSize("music/") != 6) {
+    return false;
+  }
+  // instances on different hosts and builds must agree on every hash.
+  if (HashPath("music/take1.wav", 15) != 0x4de0dd5ae13047b8ULL) {
+    return false;
+  }
+
+  // paths that differ in one directory or in their last digits, like the
+  // files of a session, spread evenly over the shards.
+  const unsigned int kShards = 16;
+  const unsigned int kPaths = 4096;
+  for (auto format : {"artist%u/take1.wav", "session/take%u.wav"}) {
+    unsigned int counts[kShards] = {};
+    for (unsigned int i = 0; i < kPaths; i++) {
+      char path[64];
+      int length = snprintf(path, sizeof(path), format, i);
+      counts[HashPath(path, length) % kShards]++;
+    }
+    for (auto count : counts) {
+      if (count < kPaths / kShards / 2 || count > kPaths / kShards * 3 / 2) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
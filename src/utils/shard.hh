@@ -0,0 +1,66 @@
+#ifndef WASHMYWAVES_UTILS_SHARD_H__
+#define WASHMYWAVES_UTILS_SHARD_H__
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem> // for std::filesystem::path
+
+// Shard is the part of a batch that one of several instances converts.
+// every file belongs to exactly one shard, picked from a hash of its path
+// below the directory it is found in, or of its path as it is given if it
+// is given by itself. instances given the same trees, even under different
+// mount points or working directories, split the work between them without
+// talking to each other.
+struct Shard {
+  // index of the shard, from 0 to count - 1.
+  unsigned int index = 0;
+  // number of shards, 1 converts every file.
+  unsigned int count = 1;
+};
+
+// @desc - parses a shard given as "index/count", like "3/16".
+// @param text - the text to parse.
+// @param shard - receives the shard.
+// @return bool - false if text is not a valid shard.
+bool ParseShard(const char* text, Shard& shard);
+
+// @desc - returns the 64-bit FNV-1a hash of a path, mixed so that its low
+//         bits are as good as its high bits. it only depends on the bytes of
+//         the path, so it is the same on every host and in every build.
+// @param path - the path.
+// @param length - length of path.
+// @return uint64_t
+uint64_t HashPath(const char* path, size_t length);
+
+// @desc - returns the number of leading bytes that name a directory in the
+//         paths of the files found under it, its path and a separator.
+// @param root - the directory, as it was given.
+// @return size_t
+size_t GetShardRootSize(const std::filesystem::path& root);
+
+// @desc - checks if a file belongs to a shard, by a hash of its path without
+//         the root it is found under.
+// @param path - path of the file.
+// @param root_size - number of leading bytes of path left out of the hash,
+//        from GetShardRootSize(). a file given by itself passes 0, so its
+//        path is hashed as it is given.
+// @param shard - the shard.
+// @return bool
+inline bool IsInShard(const std::filesystem::path& path, size_t root_size,
+                      const Shard& shard) {
+  if (shard.count <= 1) {
+    return true;
+  }
+  const auto& native = path.native();
+  root_size = std::min(root_size, native.size());
+  return HashPath(native.c_str() + root_size, native.size() - root_size) %
+         shard.count == shard.index;
+}
+
+// @desc - parses valid and malformed shards, and hashes paths that differ
+//         little into a few shards, checking that every shard gets its share
+//         and that the hash is the same as in every other build.
+// @return bool - true if all results are as expected.
+bool ValidateShards();
+
+#endif // WASHMYWAVES_UTILS_SHARD_H__
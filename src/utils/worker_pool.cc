@@ -0,0 +1,187 @@
+#include <unistd.h>   // for sysconf and usleep.
+#include <atomic>
+#include <set>
+#include <stdexcept>
+
+#include "utils/metrics.hh"
+#include "utils/worker_pool.hh"
+
+// the pool and the index of the worker running on the current thread. they
+// are used to queue tasks submitted by running tasks on their own worker.
+static thread_local WorkerPool* current_pool = nullptr;
+static thread_local unsigned int current_worker = 0;
+
+WorkerPool::WorkerPool(unsigned int number_of_workers) {
+  if (number_of_workers == 0) {
+    number_of_workers = GetOnlineCPUs();
+  }
+
+  // thread arguments must not move while the threads are starting, that's why
+  // both vectors are filled before any thread is created.
+  for (unsigned int i = 0; i < number_of_workers; i++) {
+    workers_.push_back(std::unique_ptr<Worker>(new Worker()));
+    thread_args_.push_back(ThreadArgs{this, i});
+  }
+  for (unsigned int i = 0; i < number_of_workers; i++) {
+    if (pthread_create(&workers_[i]->thread, NULL, ThreadEntry,
+                       &thread_args_[i])) {
+      // the threads which are already running have to be stopped before
+      // throwing, otherwise they would use a destroyed pool.
+      workers_.resize(i);
+      Join();
+      throw std::runtime_error("cannot create worker threads.");
+    }
+    GetMetrics().workers.Add(1);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  Join();
+}
+
+unsigned int WorkerPool::GetOnlineCPUs() {
+  auto cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 0 ? (unsigned int)cpus : 1;
+}
+
+unsigned int WorkerPool::GetNumberOfWorkers() const {
+  return workers_.size();
+}
+
+void WorkerPool::Submit(Task task, bool first) {
+  unsigned int index;
+  if (current_pool == this) {
+    index = current_worker;
+  } else {
+    std::lock_guard<std::mutex> guard(lock_);
+    index = next_worker_++ % workers_.size();
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(workers_[index]->lock);
+    if (first) {
+      workers_[index]->tasks.push_front(std::move(task));
+    } else {
+      workers_[index]->tasks.push_back(std::move(task));
+    }
+  }
+
+  // the task has to be in a deque before it is counted, a worker that claims
+  // it is then guaranteed to find it.
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    queued_++;
+    pending_++;
+  }
+  GetMetrics().tasks_queued.Add(1);
+  wakeup_.notify_one();
+}
+
+void WorkerPool::Join() {
+  {
+    std::unique_lock<std::mutex> guard(lock_);
+    if (joined_) {
+      return;
+    }
+    idle_.wait(guard, [this] { return pending_ == 0; });
+    stopping_ = true;
+    joined_ = true;
+  }
+  wakeup_.notify_all();
+
+  for (auto& worker : workers_) {
+    pthread_join(worker->thread, NULL);
+  }
+  GetMetrics().workers.Add(-(int64_t)workers_.size());
+}
+
+void* WorkerPool::ThreadEntry(void* arg) {
+  auto args = (ThreadArgs*)arg;
+  current_pool = args->pool;
+  current_worker = args->index;
+  args->pool->Run(args->index);
+  return NULL;
+}
+
+void WorkerPool::Run(unsigned int index) {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> guard(lock_);
+      wakeup_.wait(guard, [this] { return queued_ > 0 || stopping_; });
+      if (queued_ == 0) {
+        // stopping and nothing left to do.
+        return;
+      }
+      // claim a task. it is taken from the deques after releasing the lock.
+      queued_--;
+    }
+
+    auto& metrics = GetMetrics();
+    metrics.tasks_queued.Add(-1);
+    metrics.workers_busy.Add(1);
+    auto task = TakeTask(index);
+    task();
+    metrics.workers_busy.Add(-1);
+
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      pending_--;
+      if (pending_ == 0) {
+        idle_.notify_all();
+      }
+    }
+  }
+}
+
+WorkerPool::Task WorkerPool::TakeTask(unsigned int index) {
+  // every claimed task sits in one of the deques, so the loop always ends.
+  // both the owner and the thieves take from the front of a deque: the front
+  // holds the largest job the victim has not started yet, and handing that
+  // one to an idle worker is what keeps a big file from becoming the tail.
+  while (true) {
+    for (unsigned int i = 0; i < workers_.size(); i++) {
+      auto& worker = *workers_[(index + i) % workers_.size()];
+      std::lock_guard<std::mutex> guard(worker.lock);
+      if (!worker.tasks.empty()) {
+        auto task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        return task;
+      }
+    }
+  }
+}
+
+bool ValidateWorkerPool() {
+  const unsigned int kNumberOfWorkers = 4;
+  const size_t kNumberOfRoots = 8;
+  const size_t kTasksPerRoot = 64;
+  std::vector<std::atomic<unsigned int>> runs(kNumberOfRoots *
+                                              kTasksPerRoot);
+  std::mutex threads_lock;
+  std::set<pthread_t> threads;
+
+  WorkerPool pool(kNumberOfWorkers);
+  for (size_t root = 0; root < kNumberOfRoots; root++) {
+    pool.Submit([&, root] {
+      // tasks submitted here are queued on this worker, idle workers have
+      // to steal them. a few jump the queue like the segments of a file.
+      for (size_t i = 0; i < kTasksPerRoot; i++) {
+        pool.Submit([&, task = root * kTasksPerRoot + i] {
+          usleep(100);
+          runs[task]++;
+          std::lock_guard<std::mutex> guard(threads_lock);
+          threads.insert(pthread_self());
+        }, i % 8 == 0);
+      }
+    });
+  }
+  pool.Join();
+
+  for (const auto& count : runs) {
+    if (count != 1) {
+      return false;
+    }
+  }
+  // with this many tasks on few workers, more than one of them runs some.
+  return threads.size() > 1;
+}
@@ -0,0 +1,99 @@
+#ifndef WASHMYWAVES_UTILS_WORKER_POOL_H__
+#define WASHMYWAVES_UTILS_WORKER_POOL_H__
+#include <pthread.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// WorkerPool is a fixed-size pool of pthreads. each worker owns a deque of
+// tasks and workers that run out of work steal from the deques of others.
+class WorkerPool {
+public:
+  typedef std::function<void()> Task;
+
+  // @desc - starts the worker threads.
+  // @param number_of_workers - number of threads to start. 0 means one
+  //        thread per online cpu.
+  explicit WorkerPool(unsigned int number_of_workers = 0);
+
+  // @desc - waits for the queued tasks and joins the worker threads.
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // @desc - queues a task. tasks are taken by each worker in the order they
+  //         are submitted to it, so callers that want the largest jobs to
+  //         start first have to submit them first. tasks submitted from a
+  //         worker thread are queued on that worker, others are spread
+  //         round-robin over all workers.
+  // @param task - the function to run on a worker thread.
+  // @param first - queues the task in front of the others of its worker.
+  //        it is used for work which holds up a job already started, like
+  //        the segments of a file.
+  void Submit(Task task, bool first = false);
+
+  // @desc - blocks until all submitted tasks, including the ones submitted
+  //         by running tasks, are finished and then stops the workers.
+  //         no task can be submitted after calling this function.
+  void Join();
+
+  // @desc - returns number of worker threads.
+  // @return unsigned int
+  unsigned int GetNumberOfWorkers() const;
+
+  // @desc - returns number of online cpus, at least 1.
+  // @return unsigned int
+  static unsigned int GetOnlineCPUs();
+
+private:
+  struct Worker {
+    pthread_t thread;
+    std::mutex lock;
+    std::deque<Task> tasks;
+  };
+
+  struct ThreadArgs {
+    WorkerPool* pool;
+    unsigned int index;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<ThreadArgs> thread_args_;
+
+  // lock_ protects the counters below. workers sleep on wakeup_ while there
+  // is nothing queued, Join() sleeps on idle_ until nothing is pending.
+  std::mutex lock_;
+  std::condition_variable wakeup_;
+  std::condition_variable idle_;
+  // number of tasks sitting in the deques which are not claimed by a worker.
+  size_t queued_ = 0;
+  // number of tasks which are queued or running.
+  size_t pending_ = 0;
+  bool stopping_ = false;
+  bool joined_ = false;
+  unsigned int next_worker_ = 0;
+
+  static void* ThreadEntry(void* arg);
+
+  // @desc - main loop of a worker thread.
+  // @param index - index of the worker in workers_.
+  void Run(unsigned int index);
+
+  // @desc - takes a task from the worker's own deque, or steals one from
+  //         another worker. the caller must have claimed a task beforehand.
+  // @param index - index of the worker which is looking for a task.
+  // @return Task - the task to run.
+  Task TakeTask(unsigned int index);
+};
+
+// @desc - runs a tree of tasks on a pool of a few workers, most of them
+//         queued on one worker so the others have to steal them, and checks
+//         that every task runs exactly once before Join() returns.
+// @return bool - true if the pool behaves.
+bool ValidateWorkerPool();
+
+#endif // WASHMYWAVES_UTILS_WORKER_POOL_H__
@@ -1,153 +1,515 @@
 #include <iostream>   // for writing to std io.
 #include <fstream>    // for reading and writing files.
-#include <memory>     // for smart pointers.
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "lame.h"
 
+#include "io/sink.hh"
+#include "io/source.hh"
+#include "mp3/frame_header.hh"
+#include "utils/buffer_pool.hh"
 #include "utils/global.hh"
+#include "utils/metrics.hh"
+#include "utils/report.hh"
+#include "utils/worker_pool.hh"
+#include "wav/encoder.hh"
 #include "wav/header.hh"
 #include "wav/converter.hh"
 
-void ConvertWavToMP3(std::filesystem::path file_name) {
-  printf("[DOING] %s\n", file_name.c_str());
-  std::ifstream input_file(file_name);
+// number of mp3 frames a segment starts encoding before its first frame.
+// lame starts every stream from silence, so the first frames of a segment
+// encoder are not the same as the frames a single encoder would produce at
+// that point. they are encoded only to warm up the encoder and then dropped.
+const size_t kLeadInFrames = 2;
 
-  WavHeader wave_file(input_file);
-  if (!wave_file.IsValidWav()) {
-    printf("[ERROR] %s: not a valid wave file.\n", file_name.c_str());
-    return;
+// minimum number of mp3 frames in a segment, about 26 seconds at 44.1kHz.
+// shorter segments would spend too much on lead-in and lame setup.
+const size_t kMinSegmentFrames = 1000;
+
+// FileMeasurement collects the performance record of a file for the live
+// metrics and the report of a conversion. the metrics are always updated,
+// the stage times and cpu time are measured only if there is a report.
+class FileMeasurement {
+public:
+  // @desc - starts measuring a file.
+  // @param report - the report, may be nullptr.
+  // @param path - path to the wav file.
+  FileMeasurement(Report* report = nullptr,
+                  const std::filesystem::path& path = {})
+      : report_(report), start_time_(Report::GetTime()) {
+    if (report_) {
+      record_.path = path;
+      start_cpu_time_ = Report::GetThreadCPUTime();
+    }
+  }
+
+  // @desc - returns the stage times to fill in.
+  // @return StageTimes* - nullptr if nothing is measured.
+  StageTimes* GetTimes() {
+    return report_ ? &record_.times : nullptr;
+  }
+
+  // @desc - records the size and format of the input and ends the parse
+  //         stage.
+  void SetInput(const Source& input, const WavHeader& wave_file) {
+    const auto& format = wave_file.GetFormat();
+    record_.input_bytes = input.GetSize();
+    record_.audio_format = format.audio_format;
+    record_.number_of_channels = format.number_of_channels;
+    record_.sample_rate = format.sample_rate;
+    record_.bits_per_sample = format.bits_per_sample;
+    record_.valid_bits_per_sample = format.valid_bits_per_sample;
+    record_.number_of_frames = wave_file.GetNumberOfSamples();
+    record_.times.parse = Report::GetTime() - start_time_;
+  }
+
+  // @desc - records the number of segments the file is encoded in.
+  void SetNumberOfSegments(unsigned int number_of_segments) {
+    record_.number_of_segments = number_of_segments;
+  }
+
+  // @desc - adds stage times and cpu time measured by another thread.
+  void Add(const StageTimes& times, uint64_t cpu_time) {
+    record_.times.convert += times.convert;
+    record_.times.encode += times.encode;
+    record_.times.write += times.write;
+    record_.times.parse += times.parse;
+    record_.cpu_time += cpu_time;
+  }
+
+  // @desc - adds the cpu time of the calling thread since the measurement
+  //         started. it has to be called by the thread that started it.
+  void AddThreadCPUTime() {
+    if (report_) {
+      record_.cpu_time += Report::GetThreadCPUTime() - start_cpu_time_;
+      start_cpu_time_ = Report::GetThreadCPUTime();
+    }
+  }
+
+  // @desc - completes the record and adds it to the report.
+  // @param error - nullptr if the file is converted, the reason of the
+  //        failure otherwise.
+  void Finish(const char* error = nullptr) {
+    record_.error = error;
+    record_.wall_time = Report::GetTime() - start_time_;
+    auto& metrics = GetMetrics();
+    metrics.files_active.Add(-1);
+    if (error) {
+      metrics.files_failed.Add();
+    } else {
+      metrics.files_converted.Add();
+      metrics.file_duration.Observe(record_.wall_time / 1000);
+      metrics.file_size.Observe(record_.input_bytes);
+    }
+    if (!report_) {
+      return;
+    }
+    if (!error && record_.output_bytes == 0) {
+      std::error_code error_code;
+      auto size = std::filesystem::file_size(
+          std::filesystem::path(record_.path).replace_extension(".mp3"),
+          error_code);
+      record_.output_bytes = error_code ? 0 : size;
+    }
+    report_->Add(record_);
+  }
+
+  // @desc - records the sizes of a stream once it is read, its header does
+  //         not tell them.
+  void SetStreamSizes(uint64_t input_bytes, uint64_t number_of_frames,
+                      uint64_t output_bytes) {
+    record_.input_bytes = input_bytes;
+    record_.number_of_frames = number_of_frames;
+    record_.output_bytes = output_bytes;
   }
 
-  auto fmt_header = wave_file.GetFormatChunkHeader();
-  auto number_of_channels = fmt_header.number_of_channels;
-  auto sample_rate = fmt_header.sample_rate;
-  auto bits_per_sample = fmt_header.bits_per_sample;
+  // @desc - same as Finish(), for the thread that started the measurement.
+  void FinishOnThread(const char* error = nullptr) {
+    AddThreadCPUTime();
+    Finish(error);
+  }
+
+private:
+  Report* report_;
+  FileReport record_;
+  uint64_t start_time_;
+  uint64_t start_cpu_time_ = 0;
+};
+
+// SegmentWriter writes the mp3 frames of a segment encoder to a sink. it
+// drops the lead-in frames encoded before the segment and the frames encoded
+// after its end, which belong to the next segment.
+class SegmentWriter : public Sink {
+public:
+  // @param output - sink of the segment.
+  // @param skip_frames - number of lead-in frames.
+  // @param number_of_frames - number of frames to write after the lead-in.
+  SegmentWriter(Sink& output, size_t skip_frames,
+                size_t number_of_frames)
+      : output_(output), skip_frames_(skip_frames),
+        frames_left_(number_of_frames) {}
+
+  // @desc - takes mp3 data produced by lame. frames can be split between
+  //         calls, the incomplete end is kept until the rest comes.
+  bool Write(const void* data, size_t size) override {
+    pending_.insert(pending_.end(), (const char*)data,
+                    (const char*)data + size);
+    bool written = true;
+    size_t offset = 0;
+    while (pending_.size() - offset >= kMP3FrameHeaderSize) {
+      auto frame = (const uint8_t*)pending_.data() + offset;
+      auto frame_size = GetMP3FrameSize(frame);
+      if (frame_size == 0) {
+        // lame writes nothing but frames without tags. anything else is
+        // passed through if the segment is not cut at the end.
+        if (frames_left_ == SIZE_MAX) {
+          written = output_.Write(pending_.data() + offset,
+                                  pending_.size() - offset);
+        }
+        offset = pending_.size();
+        break;
+      }
+      if (pending_.size() - offset < frame_size) {
+        break;
+      }
+      if (skip_frames_ > 0) {
+        skip_frames_--;
+      } else if (frames_left_ > 0) {
+        written = output_.Write(pending_.data() + offset, frame_size);
+        if (frames_left_ != SIZE_MAX) {
+          frames_left_--;
+        }
+      }
+      offset += frame_size;
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + offset);
+    return written;
+  }
+
+  bool Close() override {
+    return output_.Close();
+  }
+
+private:
+  Sink& output_;
+  size_t skip_frames_;
+  // SIZE_MAX for the last segment, which is not cut.
+  size_t frames_left_;
+  std::vector<char> pending_;
+};
+
+// SegmentedFile is shared by the segments of a file encoded in parallel.
+// every segment writes its own part file and the segment which finishes last
+// stitches the parts together.
+struct SegmentedFile {
+  std::filesystem::path wav_path;
+  std::filesystem::path mp3_path;
+  unsigned int number_of_segments;
+  // number of mp3 frames in each segment, except the last one which takes
+  // the rest of the file.
+  uint64_t frames_per_segment;
+  // number of pcm frames in each mp3 frame.
+  uint64_t mp3_frame_size;
+  IOBackend io_backend;
+  DownmixOptions downmix;
+  // number of segments which are not finished yet.
+  std::atomic<unsigned int> segments_left;
+  std::atomic<bool> failed;
+  // record of the file, segments add their times to it under the mutex.
+  FileMeasurement measurement;
+  std::mutex measurement_mutex;
+};
+
+// @desc - returns path of the part file of a segment. the first segment is
+//         written to the mp3 file itself and the others are appended to it.
+static std::filesystem::path GetSegmentPath(const SegmentedFile& file,
+                                            unsigned int index) {
+  if (index == 0) {
+    return file.mp3_path;
+  }
+  auto path = file.mp3_path;
+  path += ".part" + std::to_string(index);
+  return path;
+}
+
+// @desc - encodes a segment of a file into its part file.
+// @param wave_file - header of the file, opened by the segment.
+// @param file - the segmented file.
+// @param index - index of the segment.
+// @param times - receives the time spent in each stage, nullptr if it is not
+//        measured.
+// @return bool - false on error.
+static bool EncodeSegment(WavHeader& wave_file, const SegmentedFile& file,
+                          unsigned int index, StageTimes* times) {
+  auto encode = GetEncodeFunction(wave_file);
+  if (!encode) {
+    return false;
+  }
+
+  // segment i holds mp3 frames [i * frames_per_segment, (i + 1) *
+  // frames_per_segment). a lame stream always starts with the same delay, so
+  // feeding the encoder from pcm frame k * mp3_frame_size makes its frames
+  // line up with the frames of a single encoder from frame k on.
   auto number_of_samples = wave_file.GetNumberOfSamples();
-  auto audio_format = wave_file.GetAudioFormat();
-
-  // mp3 format needs less space than wav.
-  auto mp3_buff_size = GetFileSize(input_file);
-  auto mp3_buff = std::unique_ptr<unsigned char>(
-      new unsigned char[mp3_buff_size]);
-  int bytes_written = 0;
-  std::unique_ptr<std::string> left_channel, right_channel;
-
-  PRINTF("audio format: %04x\n", (unsigned int)audio_format);
-  PRINTF("number of channels: %d\n", (int)number_of_channels);
-  PRINTF("sample rate: %d\n", (int)sample_rate);
-  PRINTF("byte rate: %d\n", (int)fmt_header.byte_rate);
-  PRINTF("block align: %d\n", (int)fmt_header.block_align);
-  PRINTF("bits per sample: %d\n", (int)bits_per_sample);
-  PRINTF("data size: 0x%x\n", (int)wave_file.GetDataSize());
-  PRINTF("number of samples: 0x%x\n", (int)number_of_samples);
-  PRINTF("data index: 0x%x\n", (int)wave_file.GetDataIndex());
-
-  // check for supported versions.
-  if (audio_format != WAVE_FORMAT_PCM &&
-      audio_format != WAVE_FORMAT_IEEE_FLOAT) {
-    printf("[ERROR] %s: unsupported audio format\n", file_name.c_str());
+  auto first_frame = index * file.frames_per_segment;
+  auto skip_frames = std::min(kLeadInFrames, first_frame);
+  auto first_sample = (first_frame - skip_frames) * file.mp3_frame_size;
+  auto last_segment = index == file.number_of_segments - 1;
+  // the encoder needs to look a bit past the last frame of the segment.
+  auto end_sample = last_segment ? number_of_samples :
+      std::min(number_of_samples, (first_frame + file.frames_per_segment +
+                                   kLeadInFrames) * file.mp3_frame_size);
+  if (!wave_file.SeekPCMFrame(first_sample)) {
+    return false;
+  }
+
+  lame_t flags = InitLame(wave_file, true);
+  if (!flags) {
+    return false;
+  }
+  auto output_file = OpenSink(GetSegmentPath(file, index), file.io_backend);
+  if (!output_file) {
+    lame_close(flags);
+    return false;
+  }
+  SegmentWriter writer(*output_file, skip_frames,
+                       last_segment ? SIZE_MAX : file.frames_per_segment);
+  auto encoded = EncodeFrames(wave_file, flags, encode,
+                              end_sample - first_sample, writer, times);
+  lame_close(flags);
+  auto close_time = times ? Report::GetTime() : 0;
+  auto closed = writer.Close();
+  if (times) {
+    times->write += Report::GetTime() - close_time;
+  }
+  return closed && encoded;
+}
+
+// @desc - marks a segment as finished. the last one to finish appends the
+//         part files to the mp3 file and reports the result.
+// @param file - the segmented file.
+// @param encoded - false if the segment failed.
+static void FinishSegment(SegmentedFile& file, bool encoded) {
+  if (!encoded) {
+    file.failed = true;
+  }
+  if (file.segments_left.fetch_sub(1) != 1) {
     return;
   }
-  if (number_of_channels > 2 || bits_per_sample > 32) {
-    printf("[ERROR] %s: unsupported audio format\n", file_name.c_str());
+
+  bool failed = file.failed;
+  auto stitch_time = Report::GetTime();
+  {
+    std::ofstream output_file(file.mp3_path, std::ios::app);
+    for (unsigned int i = 1; i < file.number_of_segments; i++) {
+      auto part_path = GetSegmentPath(file, i);
+      if (!failed) {
+        std::ifstream part_file(part_path);
+        if (part_file.peek() != std::ifstream::traits_type::eof()) {
+          output_file << part_file.rdbuf();
+        }
+      }
+      std::error_code error;
+      std::filesystem::remove(part_path, error);
+    }
+    failed = failed || !output_file.good();
+  }
+  // stitching the parts is writing the output.
+  file.measurement.Add({0, 0, 0, Report::GetTime() - stitch_time}, 0);
+
+  if (failed) {
+    std::error_code error;
+    std::filesystem::remove(file.mp3_path, error);
+    printf("[ERROR] %s: encoding failed\n", file.wav_path.c_str());
+    file.measurement.Finish("encoding failed");
     return;
   }
-  
-  // initialize lame.
-  lame_t flags = lame_init();
+  printf("[DONE ] %s\n", file.mp3_path.c_str());
+  file.measurement.Finish();
+}
+
+// @desc - decides in how many segments a file is encoded.
+// @param wave_file - header of the file.
+// @param input_file - input of the file, it has to be seekable.
+// @param options - conversion options.
+// @param mp3_frame_size - receives number of pcm frames in each mp3 frame.
+// @return unsigned int - number of segments, 1 if the file is not split.
+static unsigned int GetNumberOfSegments(const WavHeader& wave_file,
+                                        const Source& input_file,
+                                        const ConvertOptions& options,
+                                        uint64_t* mp3_frame_size) {
+  // mp3 frames hold at least 576 pcm frames.
+  auto number_of_samples = wave_file.GetNumberOfSamples();
+  if (options.segments < 2 || !options.pool || input_file.GetSize() == 0 ||
+      number_of_samples < 2 * kMinSegmentFrames * 576) {
+    return 1;
+  }
+
+  // the frame size depends on the output sample rate lame picks.
+  lame_t flags = InitLame(wave_file, true);
   if (!flags) {
+    return 1;
+  }
+  *mp3_frame_size = lame_get_framesize(flags);
+  lame_close(flags);
+
+  auto mp3_frames = number_of_samples / *mp3_frame_size;
+  return std::max<size_t>(1, std::min<size_t>(options.segments,
+                                               mp3_frames / kMinSegmentFrames));
+}
+
+void ConvertWavToMP3(std::filesystem::path file_name,
+                     const ConvertOptions& options) {
+  printf("[DOING] %s\n", file_name.c_str());
+#ifdef DEBUG
+  auto allocations = GET_ALLOCATIONS();
+#endif
+  GetMetrics().files_started.Add();
+  GetMetrics().files_active.Add(1);
+  FileMeasurement measurement(options.report, file_name);
+  auto input_file = OpenSource(file_name, options.io_backend);
+  if (!input_file) {
+    printf("[ERROR] %s: cannot open file.\n", file_name.c_str());
+    measurement.FinishOnThread("cannot open file");
     return;
   }
- 
-  lame_set_num_samples(flags, number_of_samples);
-  lame_set_in_samplerate(flags, sample_rate);
-  lame_set_num_channels(flags, number_of_channels);
-  lame_set_quality(flags, 2); // 2 for the good quality. 0 is the best.
 
-  if (lame_init_params(flags) < 0) {
-    throw std::runtime_error("invalid lame parametrs.");
+  WavHeader wave_file(*input_file);
+  wave_file.SetDownmix(options.downmix);
+  measurement.SetInput(*input_file, wave_file);
+  auto error = Encoder::Check(wave_file);
+  if (error) {
+    printf("[ERROR] %s: %s.\n", file_name.c_str(), error);
+    measurement.FinishOnThread(error);
+    return;
   }
+  auto number_of_samples = wave_file.GetNumberOfSamples();
 
-  // TODO: check if there exists an .mp3 file with the same name.
-  // and if yes, ask for the user permission to overwrite it.
-  std::ofstream output_file(file_name.replace_extension(".mp3"));
-
-  // read pcm data.
-  if (number_of_channels == 1) {
-    left_channel = wave_file.ReadPCMData(0);
-    HEX_DUMP((const unsigned char *)left_channel->c_str(), 0x30);
-  } else {
-    left_channel = wave_file.ReadPCMData(0);
-    right_channel = wave_file.ReadPCMData(1);
-    HEX_DUMP((const unsigned char *)left_channel->c_str(), 0x30);
-    HEX_DUMP((const unsigned char *)right_channel->c_str(), 0x30);
-  }
-
-  // encode pcm data.
-  if (number_of_channels == 1) { // mono.
-    if (audio_format == WAVE_FORMAT_PCM) {
-      if (bits_per_sample <= 16) {
-        bytes_written = lame_encode_buffer(
-            flags,                                  // lame flags
-            (const int16_t*)left_channel->c_str(),  // left channel buffer
-            nullptr,                                // right channel buffer
-            number_of_samples,                      // no of samples
-            mp3_buff.get(),                         // output buffer
-            mp3_buff_size);                         // output buffer size
-      } else if (bits_per_sample > 16 && bits_per_sample <= 32) {
-        bytes_written = lame_encode_buffer_int(
-            flags,                                  // lame flags
-            (const int32_t*)left_channel->c_str(),  // left channel buffer
-            nullptr,                                // right channel buffer
-            number_of_samples,                      // no of samples
-            mp3_buff.get(),                         // output buffer
-            mp3_buff_size);                         // output buffer size
-      }
-    } else if (audio_format == WAVE_FORMAT_IEEE_FLOAT) {
-      bytes_written = lame_encode_buffer_ieee_float(
-          flags,                                    // lame flags
-          (const float*)left_channel->c_str(),      // left channel buffer
-          nullptr,                                  // right channel buffer
-          number_of_samples,                        // no of samples
-          mp3_buff.get(),                           // output buffer
-          mp3_buff_size);                           // output buffer size
+  uint64_t mp3_frame_size = 0;
+  auto number_of_segments = GetNumberOfSegments(wave_file, *input_file,
+                                                options, &mp3_frame_size);
+  if (number_of_segments > 1) {
+    // long files are split in segments which other workers can pick up. the
+    // worker that finishes last writes the result, nobody waits for the
+    // others.
+    auto file = std::make_shared<SegmentedFile>();
+    file->wav_path = file_name;
+    file->mp3_path = std::filesystem::path(file_name).replace_extension(".mp3");
+    file->number_of_segments = number_of_segments;
+    file->frames_per_segment =
+        (number_of_samples / mp3_frame_size + number_of_segments - 1) /
+        number_of_segments;
+    file->mp3_frame_size = mp3_frame_size;
+    file->io_backend = options.io_backend;
+    file->downmix = options.downmix;
+    file->segments_left = number_of_segments;
+    file->failed = false;
+    file->measurement = measurement;
+    file->measurement.SetNumberOfSegments(number_of_segments);
+    auto measured = options.report != nullptr;
+    PRINTF("segments: %u of %" PRIu64 " mp3 frames\n", number_of_segments,
+           file->frames_per_segment);
+
+    // segments are queued in front of everything else, in reverse so that
+    // they are taken in order.
+    for (auto i = number_of_segments - 1; i > 0; i--) {
+      options.pool->Submit([file, i, measured] {
+        auto start_time = measured ? Report::GetTime() : 0;
+        auto start_cpu_time = measured ? Report::GetThreadCPUTime() : 0;
+        StageTimes times;
+        auto segment_input = OpenSource(file->wav_path, file->io_backend);
+        bool encoded = false;
+        if (segment_input) {
+          WavHeader segment_file(*segment_input);
+          segment_file.SetDownmix(file->downmix);
+          if (measured) {
+            times.parse = Report::GetTime() - start_time;
+          }
+          encoded = segment_file.IsValidWav() &&
+                    EncodeSegment(segment_file, *file, i,
+                                  measured ? &times : nullptr);
+        }
+        if (measured) {
+          std::lock_guard<std::mutex> lock(file->measurement_mutex);
+          file->measurement.Add(times, Report::GetThreadCPUTime() -
+                                            start_cpu_time);
+        }
+        FinishSegment(*file, encoded);
+      }, true);
     }
-  } else if (number_of_channels == 2) { // stereo.
-    if (audio_format == WAVE_FORMAT_PCM) {
-      if (bits_per_sample <= 16) {
-      bytes_written = lame_encode_buffer(
-          flags,                                    // lame flags
-          (const int16_t*)left_channel->c_str(),    // left channel buffer
-          (const int16_t*)right_channel->c_str(),   // right channel buffer
-          number_of_samples,                        // no of samples
-          mp3_buff.get(),                           // output buffer
-          mp3_buff_size);                           // output buffer size
-      } else if (bits_per_sample > 16 && bits_per_sample <= 32) {
-      bytes_written = lame_encode_buffer_int(
-          flags,                                    // lame flags
-          (const int32_t*)left_channel->c_str(),    // left channel buffer
-          (const int32_t*)right_channel->c_str(),   // right channel buffer
-          number_of_samples,                        // no of samples
-          mp3_buff.get(),                           // output buffer
-          mp3_buff_size);                           // output buffer size
-      }
-    } else if (audio_format == WAVE_FORMAT_IEEE_FLOAT) {
-      bytes_written = lame_encode_buffer_ieee_float(
-          flags,                                    // lame flags
-          (const float*)left_channel->c_str(),      // left channel buffer
-          (const float*)right_channel->c_str(),     // right channel buffer
-          number_of_samples,                        // no of samples
-          mp3_buff.get(),                           // output buffer
-          mp3_buff_size);                           // output buffer size
+    StageTimes times;
+    auto encoded = EncodeSegment(wave_file, *file, 0,
+                                 measured ? &times : nullptr);
+    {
+      std::lock_guard<std::mutex> lock(file->measurement_mutex);
+      file->measurement.Add(times, 0);
+      file->measurement.AddThreadCPUTime();
     }
+    FinishSegment(*file, encoded);
+    return;
+  }
 
-    // write encoded pcm data to mp3 file.
-    output_file.write((const char *)mp3_buff.get(), bytes_written);
-    bytes_written = lame_encode_flush(flags, mp3_buff.get(), mp3_buff_size);
-    output_file.write((const char *)mp3_buff.get(), bytes_written);
-    printf("[DONE ] %s\n", file_name.c_str());
+  // TODO: check if there exists an .mp3 file with the same name.
+  // and if yes, ask for the user permission to overwrite it.
+  auto output_file = OpenSink(file_name.replace_extension(".mp3"),
+                              options.io_backend);
+  if (!output_file) {
+    printf("[ERROR] %s: cannot create mp3 file.\n", file_name.c_str());
+    measurement.FinishOnThread("cannot create mp3 file");
+    return;
   }
 
-  lame_close(flags);
+  // the rest of the file is encoded in one pass.
+  Encoder encoder(options.reuse_encoders);
+  if (!encoder.Encode(wave_file, *output_file, measurement.GetTimes())) {
+    // no part of a failed file is kept, like a failed segmented one.
+    output_file.reset();
+    std::error_code error;
+    std::filesystem::remove(file_name, error);
+    printf("[ERROR] %s: %s.\n", file_name.c_str(), encoder.GetError());
+    measurement.FinishOnThread(encoder.GetError());
+    return;
+  }
+  printf("[DONE ] %s\n", file_name.c_str());
+  measurement.FinishOnThread();
+  PRINTF("heap allocations: %" PRIu64 "\n",
+         GET_ALLOCATIONS() - allocations);
+}
+
+bool ConvertWavStream(Source& input, Sink& output,
+                      const ConvertOptions& options) {
+  // the stream is named like the argument it is given with.
+  static const char kName[] = "-";
+  printf("[DOING] %s\n", kName);
+  GetMetrics().files_started.Add();
+  GetMetrics().files_active.Add(1);
+  FileMeasurement measurement(options.report, kName);
+
+  // the header is parsed up to data chunk, which is then read to its end.
+  // nothing is seeked and nothing is held beyond the block being encoded.
+  WavHeader wave_file(input);
+  wave_file.SetDownmix(options.downmix);
+  measurement.SetInput(input, wave_file);
+  Encoder encoder(options.reuse_encoders);
+  auto encoded = encoder.Encode(wave_file, output, measurement.GetTimes());
+  if (wave_file.IsValidWav()) {
+    auto data_read = input.Tell() - wave_file.GetDataIndex();
+    measurement.SetStreamSizes(input.Tell(),
+                               data_read / wave_file.GetFormat().block_align,
+                               encoder.GetBytesWritten());
+  }
+  if (!encoded) {
+    printf("[ERROR] %s: %s.\n", kName, encoder.GetError());
+    measurement.FinishOnThread(encoder.GetError());
+    return false;
+  }
+  printf("[DONE ] %s\n", kName);
+  measurement.FinishOnThread();
+  return true;
 }
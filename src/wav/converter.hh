@@ -2,8 +2,51 @@
 #define WASHMYWAVES_WAV_CONVERTER_H__
 #include <filesystem> // for std::filesystem::path
 
+#include "io/source.hh"
+#include "wav/downmix.hh"
+
+class Report;
+class Sink;
+class WorkerPool;
+
+// ConvertOptions are the settings of a conversion.
+struct ConvertOptions {
+  // maximum number of segments a long file is split into. segments are
+  // encoded in parallel and stitched into one mp3 file, 1 disables it.
+  unsigned int segments = 1;
+  // pool that segments are submitted to. files are not split without it.
+  WorkerPool* pool = nullptr;
+  // how wav files are read and mp3 files are written.
+  IOBackend io_backend = IOBackend::kBlocking;
+  // keeps initialized encoders on each worker and reuses them for files of
+  // the same format. lame_init_bitstream() does not reset all of the state
+  // of an encoder, so the output of a reused one slightly depends on the
+  // file it encoded before. it differs from the output of new encoders even
+  // with one job, and between runs with more than one job.
+  bool reuse_encoders = false;
+  // receives a performance record of every file, nullptr if there is no
+  // report. nothing is measured without it.
+  Report* report = nullptr;
+  // how files with more than 2 channels are mixed down.
+  DownmixOptions downmix;
+};
+
 // @desc - converts a wav file to a mp3 file. the result will be saved 
 //         under the same path and similar name with .mp3 extension.
 // @param file_name - path to .wav file.
-void ConvertWavToMP3(std::filesystem::path file_name);
+// @param options - conversion options.
+void ConvertWavToMP3(std::filesystem::path file_name,
+                     const ConvertOptions& options = ConvertOptions());
+
+// @desc - converts a wav stream to a mp3 stream, like a pipe in a shell.
+//         the input is read once from start to end and the mp3 data is
+//         written as it is encoded, nothing is seeked. the data size may be
+//         left 0 or 0xFFFFFFFF by a streaming writer, the stream is then
+//         read to its end. files are not split into segments.
+// @param input - the wav stream.
+// @param output - receives the mp3 data, it is closed at the end.
+// @param options - conversion options.
+// @return bool - false on error.
+bool ConvertWavStream(Source& input, Sink& output,
+                      const ConvertOptions& options = ConvertOptions());
 #endif // WASHMYWAVES_WAV_CONVERTER_H__
@@ -0,0 +1,233 @@
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+
+#include "wav/downmix.hh"
+
+// speaker positions of the channel mask of wave format extensible.
+#define SPEAKER_FRONT_LEFT            0x00001
+#define SPEAKER_FRONT_RIGHT           0x00002
+#define SPEAKER_FRONT_CENTER          0x00004
+#define SPEAKER_LOW_FREQUENCY         0x00008
+#define SPEAKER_BACK_LEFT             0x00010
+#define SPEAKER_BACK_RIGHT            0x00020
+#define SPEAKER_FRONT_LEFT_OF_CENTER  0x00040
+#define SPEAKER_FRONT_RIGHT_OF_CENTER 0x00080
+#define SPEAKER_SIDE_LEFT             0x00200
+#define SPEAKER_SIDE_RIGHT            0x00400
+#define SPEAKER_TOP_FRONT_LEFT        0x01000
+#define SPEAKER_TOP_FRONT_RIGHT       0x04000
+#define SPEAKER_TOP_BACK_LEFT         0x08000
+#define SPEAKER_TOP_BACK_RIGHT        0x20000
+
+// -3dB, the gain of a speaker that is shared by two sides or folded into
+// one.
+const float kMinus3dB = 0.70710678f;
+
+// usual layouts of 1 to 8 channels without a channel mask, indexed by
+// [channels - 1]: mono, stereo, 3.0, quad, 5.0, 5.1, 6.1 and 7.1.
+const uint32_t kDefaultChannelMasks[] = {
+  0x4, 0x3, 0x7, 0x33, 0x37, 0x3f, 0x13f, 0x63f,
+};
+
+// @desc - returns the gains of a speaker on the left and right outputs.
+// @param speaker - a single bit of the channel mask, 0 if the channel has no
+//        position.
+// @param left, right - receive the gains.
+static void GetSpeakerGains(uint32_t speaker, float& left, float& right) {
+  switch (speaker) {
+    case SPEAKER_FRONT_LEFT:
+    case SPEAKER_FRONT_LEFT_OF_CENTER:
+      left = 1;
+      right = 0;
+      return;
+    case SPEAKER_FRONT_RIGHT:
+    case SPEAKER_FRONT_RIGHT_OF_CENTER:
+      left = 0;
+      right = 1;
+      return;
+    case SPEAKER_BACK_LEFT:
+    case SPEAKER_SIDE_LEFT:
+    case SPEAKER_TOP_FRONT_LEFT:
+    case SPEAKER_TOP_BACK_LEFT:
+      left = kMinus3dB;
+      right = 0;
+      return;
+    case SPEAKER_BACK_RIGHT:
+    case SPEAKER_SIDE_RIGHT:
+    case SPEAKER_TOP_FRONT_RIGHT:
+    case SPEAKER_TOP_BACK_RIGHT:
+      left = 0;
+      right = kMinus3dB;
+      return;
+    case SPEAKER_LOW_FREQUENCY:
+      // lame encodes no separate lfe channel, and the bass of the other
+      // speakers is usually all of it that matters.
+      left = 0;
+      right = 0;
+      return;
+    default:
+      // centre speakers, and channels without a position.
+      left = kMinus3dB;
+      right = kMinus3dB;
+      return;
+  }
+}
+
+DownmixMatrix MakeDownmixMatrix(uint32_t channel_mask,
+                                unsigned int input_channels,
+                                unsigned int output_channels) {
+  DownmixMatrix matrix;
+  matrix.input_channels = input_channels;
+  matrix.output_channels = output_channels;
+  if ((unsigned int)__builtin_popcount(channel_mask) != input_channels &&
+      input_channels <= std::size(kDefaultChannelMasks)) {
+    channel_mask = kDefaultChannelMasks[input_channels - 1];
+  }
+
+  // channels take the positions of the mask bits in order, from the lowest.
+  float row_sums[2] = {0, 0};
+  for (unsigned int c = 0; c < input_channels; c++) {
+    uint32_t speaker = channel_mask & -channel_mask;
+    channel_mask &= ~speaker;
+    GetSpeakerGains(speaker, matrix.gains[0][c], matrix.gains[1][c]);
+    row_sums[0] += matrix.gains[0][c];
+    row_sums[1] += matrix.gains[1][c];
+  }
+  auto max_sum = std::fmax(row_sums[0], row_sums[1]);
+  auto scale = max_sum > 1 ? 1 / max_sum : 1.0f;
+  for (unsigned int c = 0; c < input_channels; c++) {
+    matrix.gains[0][c] *= scale;
+    matrix.gains[1][c] *= scale;
+    if (output_channels == 1) {
+      matrix.gains[0][c] = (matrix.gains[0][c] + matrix.gains[1][c]) / 2;
+      matrix.gains[1][c] = 0;
+    }
+  }
+  return matrix;
+}
+
+bool ParseDownmixMatrix(const char* text, DownmixMatrix& matrix) {
+  DownmixMatrix result;
+  const char* cursor = text;
+  for (unsigned int row = 0; row < 2; row++) {
+    unsigned int channels = 0;
+    while (true) {
+      char* end = nullptr;
+      auto gain = strtof(cursor, &end);
+      if (end == cursor || !std::isfinite(gain) ||
+          channels == kMaxDownmixChannels) {
+        return false;
+      }
+      result.gains[row][channels++] = gain;
+      cursor = end;
+      if (*cursor != ',') {
+        break;
+      }
+      cursor++;
+    }
+    // every row mixes the same channels.
+    if (row > 0 && channels != result.input_channels) {
+      return false;
+    }
+    result.input_channels = channels;
+    result.output_channels = row + 1;
+    if (*cursor != ';' || row == 1) {
+      break;
+    }
+    cursor++;
+  }
+  if (*cursor != '\0') {
+    return false;
+  }
+  matrix = result;
+  return true;
+}
+
+bool ValidateDownmixMatrices() {
+  // gains are compared with some room for the rounding of the scale.
+  const float kTolerance = 1e-6f;
+  for (unsigned int channels = 1; channels <= kMaxDownmixChannels;
+       channels++) {
+    auto stereo = MakeDownmixMatrix(0, channels, 2);
+    auto mono = MakeDownmixMatrix(0, channels, 1);
+    if (stereo.input_channels != channels || stereo.output_channels != 2 ||
+        mono.input_channels != channels || mono.output_channels != 1) {
+      return false;
+    }
+    float sums[2] = {0, 0};
+    for (unsigned int c = 0; c < channels; c++) {
+      auto average = (stereo.gains[0][c] + stereo.gains[1][c]) / 2;
+      if (stereo.gains[0][c] < 0 || stereo.gains[1][c] < 0 ||
+          std::fabs(mono.gains[0][c] - average) > kTolerance ||
+          mono.gains[1][c] != 0) {
+        return false;
+      }
+      sums[0] += stereo.gains[0][c];
+      sums[1] += stereo.gains[1][c];
+    }
+    // a full scale signal on every channel does not clip.
+    if (sums[0] > 1 + kTolerance || sums[1] > 1 + kTolerance) {
+      return false;
+    }
+  }
+
+  // stereo stays as it is, 5.1 keeps its sides apart, drops lfe and shares
+  // the centre. a mask that does not name every channel is replaced.
+  auto stereo = MakeDownmixMatrix(0x3, 2, 2);
+  if (stereo.gains[0][0] != 1 || stereo.gains[0][1] != 0 ||
+      stereo.gains[1][0] != 0 || stereo.gains[1][1] != 1) {
+    return false;
+  }
+  auto surround = MakeDownmixMatrix(0x3f, 6, 2);
+  auto guessed = MakeDownmixMatrix(0x3, 6, 2);
+  for (unsigned int c = 0; c < 6; c++) {
+    if (guessed.gains[0][c] != surround.gains[0][c] ||
+        guessed.gains[1][c] != surround.gains[1][c]) {
+      return false;
+    }
+  }
+  if (surround.gains[1][0] != 0 || surround.gains[0][1] != 0 ||
+      surround.gains[0][2] != surround.gains[1][2] ||
+      surround.gains[0][3] != 0 || surround.gains[1][3] != 0 ||
+      surround.gains[1][4] != 0 || surround.gains[0][5] != 0 ||
+      surround.gains[0][0] != surround.gains[1][1]) {
+    return false;
+  }
+
+  DownmixMatrix matrix;
+  if (!ParseDownmixMatrix("1,0,0.707,0,0.707,0;0,1,0.707,0,0,0.707",
+                          matrix) ||
+      matrix.input_channels != 6 || matrix.output_channels != 2 ||
+      matrix.gains[0][2] != 0.707f || matrix.gains[1][5] != 0.707f) {
+    return false;
+  }
+  if (!ParseDownmixMatrix("0.5,0.5", matrix) || matrix.input_channels != 2 ||
+      matrix.output_channels != 1 || matrix.gains[0][1] != 0.5f) {
+    return false;
+  }
+  std::string widest = "1";
+  for (unsigned int c = 1; c < kMaxDownmixChannels; c++) {
+    widest += ",0";
+  }
+  if (!ParseDownmixMatrix(widest.c_str(), matrix) ||
+      matrix.input_channels != kMaxDownmixChannels) {
+    return false;
+  }
+
+  // a malformed matrix leaves the previous one as it is.
+  std::string too_wide = widest + ",0";
+  const char* kMalformed[] = {
+    "", ",", ";", "1,", ",1", "1,,1", "1;", ";1", "1,0;0", "1;0,1", "1;1;1",
+    "1,0;0,1x", "1 ,0", "x", "nan", "inf,0", "1,0;0,-inf",
+    too_wide.c_str(),
+  };
+  for (auto text : kMalformed) {
+    if (ParseDownmixMatrix(text, matrix) ||
+        matrix.input_channels != kMaxDownmixChannels) {
+      return false;
+    }
+  }
+  return true;
+}
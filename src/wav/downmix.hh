@@ -0,0 +1,61 @@
+#ifndef WASHMYWAVES_WAV_DOWNMIX_H__
+#define WASHMYWAVES_WAV_DOWNMIX_H__
+#include <cstdint>
+
+// maximum number of input channels of a downmix. wave format extensible
+// names 18 speaker positions, the rest leaves room for unnamed channels.
+const unsigned int kMaxDownmixChannels = 32;
+
+// DownmixMatrix mixes the channels of a frame into one or two output
+// channels. output channel o of a frame is the sum of input channel c times
+// gains[o][c], added in channel order.
+struct DownmixMatrix {
+  // number of channels of the input, 0 if there is no matrix.
+  unsigned int input_channels = 0;
+  // 1 for mono, 2 for stereo.
+  unsigned int output_channels = 0;
+  float gains[2][kMaxDownmixChannels] = {};
+};
+
+// DownmixOptions tells how files with more channels than lame takes are
+// mixed down.
+struct DownmixOptions {
+  // channels that files with more of them are mixed down to, 1 or 2.
+  unsigned int output_channels = 2;
+  // matrix of files with exactly matrix.input_channels channels, it replaces
+  // the standard one for them. files with other channel counts are mixed
+  // with the standard matrix.
+  DownmixMatrix matrix;
+};
+
+// @desc - builds the standard matrix of a speaker layout, after ITU-R
+//         BS.775. front speakers go to their own side, surround and top
+//         speakers go to their side at -3dB, centre speakers go to both
+//         sides at -3dB and LFE is dropped. gains are scaled down so a full
+//         scale signal on every channel does not clip. mono is the average
+//         of the stereo mix.
+// @param channel_mask - speaker positions of the channels, in the order of
+//        their bits. a mask that does not name every channel is replaced
+//        with the usual layout of the channel count.
+// @param input_channels - number of channels, 1 to kMaxDownmixChannels.
+// @param output_channels - 1 or 2.
+// @return DownmixMatrix
+DownmixMatrix MakeDownmixMatrix(uint32_t channel_mask,
+                                unsigned int input_channels,
+                                unsigned int output_channels);
+
+// @desc - parses a matrix given as rows of gains, one row per output
+//         channel, like "1,0,0.707,0,0.707,0;0,1,0.707,0,0,0.707". rows are
+//         separated by ';' and gains by ','.
+// @param text - the text to parse.
+// @param matrix - receives the matrix.
+// @return bool - false if text is not a valid matrix.
+bool ParseDownmixMatrix(const char* text, DownmixMatrix& matrix);
+
+// @desc - builds the standard matrices of every channel count and checks
+//         that they do not clip and keep left and right apart, and parses
+//         valid and malformed matrices.
+// @return bool - true if all results are as expected.
+bool ValidateDownmixMatrices();
+
+#endif // WASHMYWAVES_WAV_DOWNMIX_H__
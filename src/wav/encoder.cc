@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <cstdint>
+
+#include "io/memory_source.hh"
+#include "utils/buffer_pool.hh"
+#include "utils/global.hh"
+#include "utils/metrics.hh"
+#include "wav/encoder_cache.hh"
+#include "wav/encoder.hh"
+
+// lame quality of every encoder, 2 for the good quality. 0 is the best.
+const int kQuality = 2;
+
+// number of samples lame is told about for wav streams of unknown length,
+// the default of lame which stands for an unknown number.
+const unsigned long kUnknownNumberOfSamples = 0xFFFFFFFF;
+
+// mono blocks are passed as the left channel with no right channel.
+static int EncodeMonoInt16(lame_t flags, const void* samples,
+                           size_t number_of_frames, unsigned char* mp3_buff) {
+  return lame_encode_buffer(flags, (const int16_t*)samples, nullptr,
+                            number_of_frames, mp3_buff, kMP3BufferSize);
+}
+
+static int EncodeMonoInt32(lame_t flags, const void* samples,
+                           size_t number_of_frames, unsigned char* mp3_buff) {
+  return lame_encode_buffer_int(flags, (const int32_t*)samples, nullptr,
+                                number_of_frames, mp3_buff, kMP3BufferSize);
+}
+
+static int EncodeMonoFloat(lame_t flags, const void* samples,
+                           size_t number_of_frames, unsigned char* mp3_buff) {
+  return lame_encode_buffer_ieee_float(flags, (const float*)samples, nullptr,
+                                       number_of_frames, mp3_buff,
+                                       kMP3BufferSize);
+}
+
+static int EncodeMonoDouble(lame_t flags, const void* samples,
+                            size_t number_of_frames, unsigned char* mp3_buff) {
+  return lame_encode_buffer_ieee_double(flags, (const double*)samples, nullptr,
+                                        number_of_frames, mp3_buff,
+                                        kMP3BufferSize);
+}
+
+// stereo blocks are handed to lame interleaved, as they are read.
+static int EncodeStereoInt16(lame_t flags, const void* samples,
+                             size_t number_of_frames,
+                             unsigned char* mp3_buff) {
+  // lame only reads the buffer, it is not const in lame.h.
+  return lame_encode_buffer_interleaved(flags, (int16_t*)samples,
+                                        number_of_frames, mp3_buff,
+                                        kMP3BufferSize);
+}
+
+static int EncodeStereoInt32(lame_t flags, const void* samples,
+                             size_t number_of_frames,
+                             unsigned char* mp3_buff) {
+  return lame_encode_buffer_interleaved_int(flags, (const int32_t*)samples,
+                                            number_of_frames, mp3_buff,
+                                            kMP3BufferSize);
+}
+
+static int EncodeStereoFloat(lame_t flags, const void* samples,
+                             size_t number_of_frames,
+                             unsigned char* mp3_buff) {
+  return lame_encode_buffer_interleaved_ieee_float(
+      flags, (const float*)samples, number_of_frames, mp3_buff,
+      kMP3BufferSize);
+}
+
+static int EncodeStereoDouble(lame_t flags, const void* samples,
+                              size_t number_of_frames,
+                              unsigned char* mp3_buff) {
+  return lame_encode_buffer_interleaved_ieee_double(
+      flags, (const double*)samples, number_of_frames, mp3_buff,
+      kMP3BufferSize);
+}
+
+// encode functions indexed by [SampleType][channels - 1].
+static const EncodeFunction kEncodeFunctions[4][2] = {
+  {EncodeMonoInt16, EncodeStereoInt16},     // SampleType::kInt16
+  {EncodeMonoInt32, EncodeStereoInt32},     // SampleType::kInt32
+  {EncodeMonoFloat, EncodeStereoFloat},     // SampleType::kFloat
+  {EncodeMonoDouble, EncodeStereoDouble},   // SampleType::kDouble
+};
+
+// @desc - returns the number of samples of a wav file, as lame takes it.
+//         lame only counts up to 32 bits, longer files are encoded as if
+//         their length was unknown.
+static unsigned long GetLameNumberOfSamples(const WavHeader& wave_file) {
+  if (!wave_file.IsDataSizeKnown()) {
+    return kUnknownNumberOfSamples;
+  }
+  return std::min<uint64_t>(wave_file.GetNumberOfSamples(),
+                            kUnknownNumberOfSamples);
+}
+
+lame_t InitLame(const WavHeader& wave_file, bool segmented) {
+  auto fmt_header = wave_file.GetFormatChunkHeader();
+  lame_t flags = lame_init();
+  if (!flags) {
+    return nullptr;
+  }
+
+  lame_set_num_samples(flags, GetLameNumberOfSamples(wave_file));
+  lame_set_in_samplerate(flags, fmt_header.sample_rate);
+  lame_set_num_channels(flags, wave_file.GetOutputChannels());
+  lame_set_quality(flags, kQuality);
+  if (segmented) {
+    lame_set_disable_reservoir(flags, 1);
+    lame_set_bWriteVbrTag(flags, 0);
+  }
+
+  if (lame_init_params(flags) < 0) {
+    lame_close(flags);
+    return nullptr;
+  }
+  return flags;
+}
+
+bool EncodeFrames(WavHeader& wave_file, lame_t flags, EncodeFunction encode,
+                  uint64_t number_of_frames, Sink& output,
+                  StageTimes* times) {
+  // pcm data is read, converted and encoded block by block, so the memory
+  // needed for a file does not depend on its size. samples lame takes as
+  // they are, 16-bits integers and floats, are encoded straight from the
+  // input without a copy. lame_get_size_mp3buffer() only tells what lame
+  // holds at the moment, so the buffer is sized for the worst case and taken
+  // from the pool of the worker.
+  PooledBuffer mp3_buff(kMP3BufferSize);
+  auto& metrics = GetMetrics();
+  auto block_align = wave_file.GetFormat().block_align;
+
+  // adds the time since the previous lap to a stage.
+  uint64_t lap_time = times ? Report::GetTime() : 0;
+  auto lap = [times, &lap_time](uint64_t StageTimes::*stage) {
+    if (times) {
+      auto now = Report::GetTime();
+      times->*stage += now - lap_time;
+      lap_time = now;
+    }
+  };
+
+  const void* samples;
+  size_t frames;
+  while (number_of_frames > 0 &&
+         (frames = wave_file.FetchPCMFrames(
+              std::min<uint64_t>(kFramesPerBlock, number_of_frames),
+              &samples)) > 0) {
+    lap(&StageTimes::convert);
+    auto bytes_written = encode(flags, samples, frames, mp3_buff.GetData());
+    lap(&StageTimes::encode);
+    if (bytes_written < 0) {
+      return false;
+    }
+    // write encoded pcm data to mp3 file.
+    if (!output.Write(mp3_buff.GetData(), bytes_written)) {
+      return false;
+    }
+    lap(&StageTimes::write);
+    number_of_frames -= frames;
+    metrics.input_bytes.Add(frames * block_align);
+    metrics.output_bytes.Add(bytes_written);
+    metrics.frames_encoded.Add(frames);
+  }
+  lap(&StageTimes::convert);
+
+  auto bytes_written = lame_encode_flush(flags, mp3_buff.GetData(),
+                                         kMP3BufferSize);
+  lap(&StageTimes::encode);
+  if (bytes_written < 0) {
+    return false;
+  }
+  auto written = output.Write(mp3_buff.GetData(), bytes_written);
+  lap(&StageTimes::write);
+  metrics.output_bytes.Add(bytes_written);
+  return written;
+}
+
+EncodeFunction GetEncodeFunction(const WavHeader& wave_file) {
+  const auto& pcm_kernel = wave_file.GetPCMKernel();
+  if (!pcm_kernel.IsSupported()) {
+    return nullptr;
+  }
+  return kEncodeFunctions[(int)pcm_kernel.sample_type]
+                         [wave_file.GetOutputChannels() - 1];
+}
+
+// CountingSink passes mp3 data on to a sink and counts it.
+class CountingSink : public Sink {
+public:
+  // @param output - the sink data is written to.
+  explicit CountingSink(Sink& output) : output_(output) {}
+
+  bool Write(const void* data, size_t size) override {
+    bytes_written_ += size;
+    return output_.Write(data, size);
+  }
+
+  bool Close() override {
+    return output_.Close();
+  }
+
+  // @desc - returns number of bytes written so far.
+  // @return uint64_t
+  uint64_t GetBytesWritten() const {
+    return bytes_written_;
+  }
+
+private:
+  Sink& output_;
+  uint64_t bytes_written_ = 0;
+};
+
+// @desc - returns the key of the encoders that fit a wav file.
+static EncoderKey GetEncoderKey(const WavHeader& wave_file) {
+  const auto& format = wave_file.GetFormat();
+  return {(int)format.sample_rate, (int)wave_file.GetOutputChannels(),
+          kQuality};
+}
+
+// @desc - initializes lame for a file encoded in one pass, or takes an
+//         encoder of the same format which the worker has already
+//         initialized for an earlier file. setting up the encoder is counted
+//         as encoding.
+// @param times - receives the setup time, nullptr if it is not measured.
+// @return lame_t - the flags, nullptr on error.
+static lame_t AcquireLame(const WavHeader& wave_file, bool reuse_encoders,
+                          StageTimes* times) {
+  auto init_time = times ? Report::GetTime() : 0;
+  lame_t flags = nullptr;
+  if (reuse_encoders) {
+    flags = AcquireEncoder(GetEncoderKey(wave_file));
+    if (flags) {
+      lame_set_num_samples(flags, GetLameNumberOfSamples(wave_file));
+    }
+  }
+  if (!flags) {
+    flags = InitLame(wave_file, false);
+  }
+  if (times) {
+    times->encode += Report::GetTime() - init_time;
+  }
+  return flags;
+}
+
+// @desc - gives an encoder of a file which is encoded back to the worker, or
+//         closes it if encoders are not reused.
+static void ReleaseLame(const WavHeader& wave_file, lame_t flags,
+                        bool reuse_encoders) {
+  if (reuse_encoders) {
+    ReleaseEncoder(GetEncoderKey(wave_file), flags);
+  } else {
+    lame_close(flags);
+  }
+}
+
+Encoder::Encoder(bool reuse_encoders, const DownmixOptions& downmix)
+    : reuse_encoders_(reuse_encoders), downmix_(downmix) {
+}
+
+bool Encoder::EncodeWav(const void* data, size_t size,
+                        const WriteCallback& write) {
+  MemorySource input((const uint8_t*)data, size);
+  CallbackSink output(write);
+  return Encode(input, output);
+}
+
+bool Encoder::EncodeWav(const ReadCallback& read,
+                        const WriteCallback& write) {
+  CallbackSource input(read);
+  CallbackSink output(write);
+  return Encode(input, output);
+}
+
+bool Encoder::EncodePCM(const WavHeader::Format& format, const void* data,
+                        size_t size, const WriteCallback& write) {
+  MemorySource input((const uint8_t*)data, size);
+  WavHeader wave_file(input, format);
+  wave_file.SetDownmix(downmix_);
+  CallbackSink output(write);
+  return Encode(wave_file, output);
+}
+
+bool Encoder::EncodePCM(const WavHeader::Format& format,
+                        const ReadCallback& read,
+                        const WriteCallback& write) {
+  CallbackSource input(read);
+  WavHeader wave_file(input, format);
+  wave_file.SetDownmix(downmix_);
+  CallbackSink output(write);
+  return Encode(wave_file, output);
+}
+
+bool Encoder::Encode(Source& input, Sink& output, StageTimes* times) {
+  auto parse_time = times ? Report::GetTime() : 0;
+  WavHeader wave_file(input);
+  wave_file.SetDownmix(downmix_);
+  if (times) {
+    times->parse += Report::GetTime() - parse_time;
+  }
+  return Encode(wave_file, output, times);
+}
+
+bool Encoder::Encode(WavHeader& wave_file, Sink& output, StageTimes* times) {
+  bytes_written_ = 0;
+  auto error = Check(wave_file);
+  if (error) {
+    return SetError(error);
+  }
+
+#ifdef DEBUG
+  auto fmt_header = wave_file.GetFormatChunkHeader();
+  PRINTF("audio format: %04x\n", (unsigned int)wave_file.GetAudioFormat());
+  PRINTF("number of channels: %d\n", (int)fmt_header.number_of_channels);
+  PRINTF("sample rate: %d\n", (int)fmt_header.sample_rate);
+  PRINTF("byte rate: %d\n", (int)fmt_header.byte_rate);
+  PRINTF("block align: %d\n", (int)fmt_header.block_align);
+  PRINTF("bits per sample: %d\n", (int)fmt_header.bits_per_sample);
+  PRINTF("data size: 0x%" PRIx64 "\n", wave_file.GetDataSize());
+  PRINTF("number of samples: 0x%" PRIx64 "\n",
+         wave_file.GetNumberOfSamples());
+  PRINTF("data index: 0x%" PRIx64 "\n", wave_file.GetDataIndex());
+#endif
+
+  auto flags = AcquireLame(wave_file, reuse_encoders_, times);
+  if (!flags) {
+    return SetError("cannot initialize lame");
+  }
+
+  // the kernel and the encode function are decided here once, the encode
+  // loop only calls them.
+  CountingSink counted_output(output);
+  auto encoded = EncodeFrames(wave_file, flags, GetEncodeFunction(wave_file),
+                              wave_file.GetNumberOfSamples(), counted_output,
+                              times);
+  auto close_time = times ? Report::GetTime() : 0;
+  auto closed = counted_output.Close();
+  if (times) {
+    times->write += Report::GetTime() - close_time;
+  }
+  bytes_written_ = counted_output.GetBytesWritten();
+  if (!closed || !encoded) {
+    lame_close(flags);
+    return SetError("encoding failed");
+  }
+  ReleaseLame(wave_file, flags, reuse_encoders_);
+  return SetError(nullptr);
+}
+
+const char* Encoder::Check(const WavHeader& wave_file) {
+  if (!wave_file.IsValidWav()) {
+    return "not a valid wave file";
+  }
+  // check for supported versions.
+  if (!GetEncodeFunction(wave_file)) {
+    return "unsupported audio format";
+  }
+  return nullptr;
+}
+
+const char* Encoder::GetError() const {
+  return error_;
+}
+
+uint64_t Encoder::GetBytesWritten() const {
+  return bytes_written_;
+}
+
+bool Encoder::SetError(const char* error) {
+  error_ = error;
+  return error == nullptr;
+}
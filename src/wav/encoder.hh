@@ -0,0 +1,155 @@
+#ifndef WASHMYWAVES_WAV_ENCODER_H__
+#define WASHMYWAVES_WAV_ENCODER_H__
+#include <cstddef>
+#include <cstdint>
+
+#include "lame.h"
+
+#include "io/callback_source.hh"
+#include "io/sink.hh"
+#include "io/source.hh"
+#include "utils/report.hh"
+#include "wav/header.hh"
+
+// number of frames read, converted and encoded in one step. it is a multiple
+// of the mp3 frame size (1152 samples for mpeg-1, 576 for mpeg-2), so lame
+// can encode whole frames out of each block.
+const size_t kFramesPerBlock = 8 * 1152;
+
+// worst case size of the mp3 data produced by encoding kFramesPerBlock frames,
+// as documented in lame.h: 1.25 * number of samples + 7200.
+const size_t kMP3BufferSize = kFramesPerBlock * 5 / 4 + 7200;
+
+// EncodeFunction encodes a block of pcm data read by
+// WavHeader::ReadPCMFrames(). there is one for each (sample type, number of
+// channels) pair, picked once per file by GetEncodeFunction().
+// @param flags - initialized lame flags.
+// @param samples - interleaved samples buffer.
+// @param number_of_frames - number of samples in each channel.
+// @param mp3_buff - output buffer of kMP3BufferSize bytes.
+// @return int - number of bytes written in mp3_buff, negative on error.
+typedef int (*EncodeFunction)(lame_t flags, const void* samples,
+                              size_t number_of_frames,
+                              unsigned char* mp3_buff);
+
+// @desc - returns the encode function of the sample type and number of
+//         channels of a file.
+// @param wave_file - header of the file.
+// @return EncodeFunction - nullptr if the format is not supported.
+EncodeFunction GetEncodeFunction(const WavHeader& wave_file);
+
+// @desc - creates and initializes lame flags for a wav file.
+// @param wave_file - header of the file.
+// @param segmented - true if the file is encoded in segments. segments are
+//        stitched together, so they are encoded without the bit reservoir and
+//        without a vbr tag, which makes every frame independent.
+// @return lame_t - the flags, nullptr on error.
+lame_t InitLame(const WavHeader& wave_file, bool segmented);
+
+// @desc - encodes pcm frames from the current position of a wav file and
+//         flushes the encoder.
+// @param wave_file - the file, its position is moved past the frames.
+// @param flags - initialized lame flags.
+// @param encode - encode function of the file's sample type and channels.
+// @param number_of_frames - maximum number of pcm frames to encode.
+// @param output - receives the mp3 data.
+// @param times - receives the time spent in each stage, nullptr if it is not
+//        measured.
+// @return bool - false if encoding or writing failed.
+bool EncodeFrames(WavHeader& wave_file, lame_t flags, EncodeFunction encode,
+                  uint64_t number_of_frames, Sink& output,
+                  StageTimes* times);
+
+// Encoder converts wav files, or raw pcm data, to mp3 in one pass. it is the
+// part of washmywaves that programs can embed instead of running the binary:
+// input comes from a buffer or a read callback and mp3 data is handed to a
+// write callback as it is encoded, so nothing touches the file system. an
+// encoder can be used for any number of conversions, one at a time.
+class Encoder {
+public:
+  // @desc - reads the next bytes of input, see CallbackSource.
+  typedef CallbackSource::ReadCallback ReadCallback;
+
+  // @desc - takes mp3 data as it is encoded, see CallbackSink.
+  typedef CallbackSink::WriteCallback WriteCallback;
+
+  // @param reuse_encoders - keeps initialized lame encoders on the calling
+  //        thread and reuses them for inputs of the same format, see
+  //        ConvertOptions::reuse_encoders.
+  // @param downmix - how inputs with more than 2 channels are mixed down.
+  explicit Encoder(bool reuse_encoders = false,
+                   const DownmixOptions& downmix = DownmixOptions());
+
+  // @desc - converts a wav file held in memory.
+  // @param data - the whole file.
+  // @param size - size of the file in bytes.
+  // @param write - receives the mp3 data.
+  // @return bool - false on error, GetError() tells why.
+  bool EncodeWav(const void* data, size_t size, const WriteCallback& write);
+
+  // @desc - converts a wav stream read through a callback. it is read once
+  //         from start to end, chunks after data chunk are not read.
+  // @param read - supplies the stream.
+  // @param write - receives the mp3 data.
+  // @return bool - false on error, GetError() tells why.
+  bool EncodeWav(const ReadCallback& read, const WriteCallback& write);
+
+  // @desc - converts raw pcm data held in memory.
+  // @param format - format of the samples. block_align and
+  //        valid_bits_per_sample are worked out if they are 0.
+  // @param data - interleaved samples.
+  // @param size - size of data in bytes.
+  // @param write - receives the mp3 data.
+  // @return bool - false on error, GetError() tells why.
+  bool EncodePCM(const WavHeader::Format& format, const void* data,
+                 size_t size, const WriteCallback& write);
+
+  // @desc - converts raw pcm data read through a callback, up to the end of
+  //         input.
+  // @param format - format of the samples, see above.
+  // @param read - supplies the samples.
+  // @param write - receives the mp3 data.
+  // @return bool - false on error, GetError() tells why.
+  bool EncodePCM(const WavHeader::Format& format, const ReadCallback& read,
+                 const WriteCallback& write);
+
+  // @desc - converts a wav file from a source to a sink.
+  // @param input - the file.
+  // @param output - receives the mp3 data, it is closed at the end.
+  // @param times - receives the time spent in each stage, nullptr if it is
+  //        not measured.
+  // @return bool - false on error, GetError() tells why.
+  bool Encode(Source& input, Sink& output, StageTimes* times = nullptr);
+
+  // @desc - same as above, for a file whose header is already parsed. it is
+  //         encoded from the beginning of data chunk and mixed down as the
+  //         header is set to, the downmix options of the encoder are not
+  //         applied.
+  bool Encode(WavHeader& wave_file, Sink& output,
+              StageTimes* times = nullptr);
+
+  // @desc - checks if a parsed file can be converted.
+  // @param wave_file - header of the file.
+  // @return const char* - nullptr if it can, the reason otherwise.
+  static const char* Check(const WavHeader& wave_file);
+
+  // @desc - returns the reason the last conversion failed.
+  // @return const char* - nullptr if it succeeded.
+  const char* GetError() const;
+
+  // @desc - returns number of mp3 bytes written by the last conversion.
+  // @return uint64_t
+  uint64_t GetBytesWritten() const;
+
+private:
+  bool reuse_encoders_;
+  DownmixOptions downmix_;
+  const char* error_ = nullptr;
+  uint64_t bytes_written_ = 0;
+
+  // @desc - records the result of a conversion.
+  // @return bool - true if there is no error.
+  bool SetError(const char* error);
+};
+
+#endif // WASHMYWAVES_WAV_ENCODER_H__
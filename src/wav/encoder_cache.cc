@@ -0,0 +1,55 @@
+#include "wav/encoder_cache.hh"
+
+// number of encoders each thread keeps. a batch rarely has more than a
+// couple of different formats.
+const int kCacheSize = 4;
+
+// EncoderCache holds the idle encoders of one thread, the most recently
+// released first.
+struct EncoderCache {
+  struct Entry {
+    EncoderKey key;
+    lame_t flags;
+  };
+  Entry entries[kCacheSize];
+  int number_of_entries = 0;
+
+  ~EncoderCache() {
+    for (int i = 0; i < number_of_entries; i++) {
+      lame_close(entries[i].flags);
+    }
+  }
+};
+
+static thread_local EncoderCache cache;
+
+lame_t AcquireEncoder(const EncoderKey& key) {
+  for (int i = 0; i < cache.number_of_entries; i++) {
+    if (cache.entries[i].key == key) {
+      auto flags = cache.entries[i].flags;
+      for (int j = i + 1; j < cache.number_of_entries; j++) {
+        cache.entries[j - 1] = cache.entries[j];
+      }
+      cache.number_of_entries--;
+      return flags;
+    }
+  }
+  return nullptr;
+}
+
+void ReleaseEncoder(const EncoderKey& key, lame_t flags) {
+  // the next stream starts with a fresh bitstream and frame counter.
+  if (lame_init_bitstream(flags) < 0) {
+    lame_close(flags);
+    return;
+  }
+  if (cache.number_of_entries == kCacheSize) {
+    cache.number_of_entries--;
+    lame_close(cache.entries[cache.number_of_entries].flags);
+  }
+  for (int i = cache.number_of_entries; i > 0; i--) {
+    cache.entries[i] = cache.entries[i - 1];
+  }
+  cache.entries[0] = {key, flags};
+  cache.number_of_entries++;
+}
@@ -0,0 +1,34 @@
+#ifndef WASHMYWAVES_WAV_ENCODER_CACHE_H__
+#define WASHMYWAVES_WAV_ENCODER_CACHE_H__
+#include "lame.h"
+
+// EncoderKey is the set of lame parameters an encoder is initialized with.
+// encoders with equal keys can be reused for one another's files.
+struct EncoderKey {
+  int sample_rate;
+  int number_of_channels;
+  int quality;
+
+  bool operator==(const EncoderKey& other) const {
+    return sample_rate == other.sample_rate &&
+           number_of_channels == other.number_of_channels &&
+           quality == other.quality;
+  }
+};
+
+// @desc - takes an initialized encoder from the cache of the current
+//         thread. lame_init_params() costs about 1.5ms, which is a large
+//         share of encoding a clip of a few seconds.
+// @param key - parameters of the encoder.
+// @return lame_t - an encoder ready for a new stream, nullptr if the cache
+//         has none for this key.
+lame_t AcquireEncoder(const EncoderKey& key);
+
+// @desc - gives a flushed encoder back to the cache of the current thread.
+//         it is reset with lame_init_bitstream() for the next file. the
+//         least recently used encoder is closed if the cache is full.
+// @param key - parameters the encoder was initialized with.
+// @param flags - the encoder, lame_encode_flush() must have been called.
+void ReleaseEncoder(const EncoderKey& key, lame_t flags);
+
+#endif // WASHMYWAVES_WAV_ENCODER_CACHE_H__
@@ -2,276 +2,647 @@
 #include <iterator>
 #include <cstring>
 #include <cmath>
+#include <vector>
 
+#include "io/memory_source.hh"
 #include "wav/header.hh"
+#include "wav/kernels.hh"
 #include "utils/global.hh"
 
 #define RIFF_CHUNK_ID 0x46464952
+#define RF64_CHUNK_ID 0x34364652
+#define BW64_CHUNK_ID 0x34365742
+#define DS64_CHUNK_ID 0x34367364
 #define RIFF_FORMAT_WAVE 0x45564157
 #define FMT_CHUNK_ID 0x20746d66
 #define DATA_CHUNK_ID 0x61746164
+#define FACT_CHUNK_ID 0x74636166
+#define LIST_CHUNK_ID 0x5453494c
 
-WavHeader::WavHeader(std::istream& input) : input_(input) {
-  if (!input_) throw std::runtime_error("cannot open input stream.");
+// sizes that streaming writers leave in data chunk, which they cannot come
+// back to.
+#define STREAMING_SIZE_ZERO 0x00000000
+#define STREAMING_SIZE_MAX 0xFFFFFFFF
+
+// number of entries of the ds64 table that are kept. the table lists chunks
+// other than data chunk which are larger than 4GiB, there is hardly ever
+// one.
+const size_t kMaxDs64Entries = 8;
+
+// bytes 2 to 15 of the sub format guid of extensible files. the guid of
+// every format with a format code is the code followed by these bytes,
+// KSDATAFORMAT_SUBTYPE_PCM is 00000001-0000-0010-8000-00aa00389b71.
+const uint8_t kSubFormatGuidTail[14] = {
+  0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38,
+  0x9b, 0x71,
+};
+
+// size of the fields of ds64 chunk, which is not padded.
+const uint64_t kDs64FieldsSize = offsetof(WavHeader::Ds64Chunk, table_length) +
+                                 sizeof(uint32_t) -
+                                 sizeof(WavHeader::ChunkHeader);
+
+WavHeader::WavHeader(Source& input) : input_(input) {
+  std::memset(&fmt_chunk_, 0, sizeof(fmt_chunk_));
+  std::memset(&format_, 0, sizeof(format_));
+  Parse();
 }
 
+WavHeader::WavHeader(Source& input, const Format& format)
+    : input_(input), format_(format) {
+  if (format_.block_align == 0) {
+    format_.block_align = (format_.bits_per_sample + 7) / 8 *
+                          format_.number_of_channels;
+  }
+  if (format_.valid_bits_per_sample == 0) {
+    format_.valid_bits_per_sample = format_.bits_per_sample;
+  }
+  // the fmt chunk is filled in as a plain wav file would have it.
+  std::memset(&fmt_chunk_, 0, sizeof(fmt_chunk_));
+  fmt_chunk_.format_tag = format_.audio_format;
+  fmt_chunk_.number_of_channels = format_.number_of_channels;
+  fmt_chunk_.sample_rate = format_.sample_rate;
+  fmt_chunk_.byte_rate = format_.sample_rate * format_.block_align;
+  fmt_chunk_.block_align = format_.block_align;
+  fmt_chunk_.bits_per_sample = format_.bits_per_sample;
+
+  is_riff_wave_ = true;
+  chunk_index_.fmt.present = true;
+  chunk_index_.data.present = true;
+  chunk_index_.data.size = input_.GetSize() ? input_.GetSize()
+                                            : kUnknownDataSize;
+  SetDownmix(DownmixOptions());
+}
+
+// @desc - copies a struct from the current position of the source. headers
+//         are copied rather than cast in place, as they may be unaligned.
+// @param source - the source to read from.
+// @param result - receives the struct, it is not changed on error.
+// @return bool - false if the source is not long enough.
 template<typename T>
-T CastBytes(std::istream& stream) {
+bool CastBytes(Source& source, T& result) {
   char bytes[sizeof(T)];
-  stream.read(bytes, sizeof(T));
-  return *(T*)(bytes);
+  if (source.Read(bytes, sizeof(T)) != sizeof(T)) {
+    return false;
+  }
+  std::memcpy(&result, bytes, sizeof(T));
+  return true;
 }
 
-bool WavHeader::IsValidWav() {
-  input_.seekg(0);
-
-  auto riff_header = CastBytes<RiffChunk>(input_);
-  if (!input_) {
+void WavHeader::Parse() {
+  RiffChunk riff_header;
+  if (!input_.Seek(0) || !CastBytes(input_, riff_header)) {
     // stream not long enough or an internal error in stream.
-    return false;
+    return;
   }
   HEX_DUMP((const unsigned char *)&riff_header, sizeof(riff_header));
-  if (riff_header.chunk_header.id != RIFF_CHUNK_ID ||
-      riff_header.format != RIFF_FORMAT_WAVE) {
-    return false;
+  auto riff_id = riff_header.chunk_header.id;
+  if ((riff_id != RIFF_CHUNK_ID && riff_id != RF64_CHUNK_ID &&
+       riff_id != BW64_CHUNK_ID) || riff_header.format != RIFF_FORMAT_WAVE) {
+    return;
   }
-  auto fmt_pos = FindFormatChunkHeader();
-  if (fmt_pos < 0) {
+  is_riff_wave_ = true;
+  is_rf64_ = riff_id != RIFF_CHUNK_ID;
+
+  // 64-bit sizes of RF64 and BW64 files.
+  Ds64Chunk ds64;
+  std::memset(&ds64, 0, sizeof(ds64));
+  Ds64TableEntry ds64_table[kMaxDs64Entries];
+  size_t ds64_entries = 0;
+
+  // inputs of unknown size, like pipes, cannot come back from data chunk.
+  // chunks after it are not needed to decode the file, so the scan stops
+  // there for them.
+  auto input_size = input_.GetSize();
+  bool scan_past_data = input_size != 0;
+  uint64_t offset = sizeof(RiffChunk);
+  do {
+    ChunkHeader chunk;
+    if (!input_.Seek(offset) || !CastBytes(input_, chunk)) {
+      // end of input, or an internal error in stream.
+      break;
+    }
+    ChunkLocation location;
+    location.present = true;
+    location.offset = offset;
+    location.size = chunk.size;
+    if (is_rf64_ && chunk.size == STREAMING_SIZE_MAX) {
+      // the real size is in ds64 chunk. data size is 0 if the file is still
+      // being written, its chunk is then handled like a streaming one below.
+      if (chunk.id == DATA_CHUNK_ID && ds64.data_size != 0) {
+        location.size = ds64.data_size;
+      }
+      for (size_t i = 0; i < ds64_entries; i++) {
+        if (ds64_table[i].id == chunk.id) {
+          location.size = (uint64_t)ds64_table[i].size_high << 32 |
+                          ds64_table[i].size_low;
+        }
+      }
+    }
+
+    if (chunk.id == DS64_CHUNK_ID && is_rf64_ && offset == sizeof(RiffChunk)) {
+      chunk_index_.ds64 = location;
+      ds64.chunk_header = chunk;
+      input_.Read(&ds64.riff_size, std::min(location.size, kDs64FieldsSize));
+      // the table is read in order, so it can come from a stream.
+      for (uint32_t i = 0; i < ds64.table_length && i < kMaxDs64Entries;
+           i++) {
+        if (!CastBytes(input_, ds64_table[i])) {
+          break;
+        }
+        ds64_entries++;
+      }
+    } else if (chunk.id == FMT_CHUNK_ID && !chunk_index_.fmt.present) {
+      chunk_index_.fmt = location;
+      // fmt chunk of non-extensible formats is shorter than FmtChunk, the
+      // missing members are left as zeroes.
+      fmt_chunk_.chunk_header = chunk;
+      input_.Read(&fmt_chunk_.format_tag,
+                  std::min<uint64_t>(chunk.size, sizeof(FmtChunk) -
+                                     offsetof(FmtChunk, format_tag)));
+    } else if (chunk.id == FACT_CHUNK_ID && !chunk_index_.fact.present) {
+      chunk_index_.fact = location;
+    } else if (chunk.id == LIST_CHUNK_ID && !chunk_index_.list.present) {
+      chunk_index_.list = location;
+    } else if (chunk.id == DATA_CHUNK_ID && !chunk_index_.data.present) {
+      auto rest_of_input = input_size ?
+          input_size - offset - sizeof(ChunkHeader) : kUnknownDataSize;
+      bool is_streaming = location.size == STREAMING_SIZE_MAX;
+      if (location.size == STREAMING_SIZE_ZERO) {
+        // 0 is also the size of an empty data chunk. it is only taken as a
+        // streaming one if data is the last chunk: the input cannot be
+        // seeked, or the riff size was not filled in either, or it ends
+        // with the header of data chunk. riff size leaves out the 8 bytes of
+        // riff chunk header, like offset leaves out those of data chunk.
+        uint64_t riff_size = is_rf64_ ? ds64.riff_size :
+                                        riff_header.chunk_header.size;
+        is_streaming = !scan_past_data || riff_size == STREAMING_SIZE_ZERO ||
+                       (!is_rf64_ && riff_size == STREAMING_SIZE_MAX) ||
+                       riff_size <= offset;
+      }
+      if (is_streaming) {
+        // the rest of input is data, whether its size is known or not.
+        location.size = rest_of_input;
+        chunk_index_.data = location;
+        break;
+      }
+      if (!is_rf64_ && input_size && rest_of_input > location.size &&
+          (rest_of_input - location.size) % (1ULL << 32) == 0) {
+        // a plain wav file larger than 4GiB, whose writer kept only the low
+        // 32 bits of data size. data runs to the end of input.
+        location.size = rest_of_input;
+        chunk_index_.data = location;
+        break;
+      }
+      chunk_index_.data = location;
+      if (!scan_past_data) {
+        break;
+      }
+    }
+
+    // chunks are padded to an even size.
+    offset += sizeof(ChunkHeader) + location.size + (location.size & 1);
+  } while (true);
+
+  if (chunk_index_.data.present) {
+    data_index_ = chunk_index_.data.offset + offsetof(DataChunk, data);
+  }
+
+  format_.audio_format = fmt_chunk_.format_tag;
+  format_.number_of_channels = fmt_chunk_.number_of_channels;
+  format_.sample_rate = fmt_chunk_.sample_rate;
+  format_.block_align = fmt_chunk_.block_align;
+  format_.bits_per_sample = fmt_chunk_.bits_per_sample;
+  format_.valid_bits_per_sample = fmt_chunk_.bits_per_sample;
+  if (fmt_chunk_.format_tag == WAVE_FORMAT_EXTENSIBLE) {
+    // the first two bytes of the sub format guid are the format code. other
+    // guids, like those of ambisonic b-format, name formats which are not
+    // supported. they are left with no format code.
+    format_.audio_format = 0;
+    if (chunk_index_.fmt.size >= sizeof(FmtChunk) - sizeof(ChunkHeader) &&
+        std::memcmp(fmt_chunk_.sub_format_guid + 2, kSubFormatGuidTail,
+                    sizeof(kSubFormatGuidTail)) == 0) {
+      format_.audio_format = fmt_chunk_.audio_format;
+    }
+    format_.channel_mask = fmt_chunk_.channel_mask;
+    if (fmt_chunk_.valid_bits_per_sample != 0 &&
+        fmt_chunk_.valid_bits_per_sample <= fmt_chunk_.bits_per_sample) {
+      format_.valid_bits_per_sample = fmt_chunk_.valid_bits_per_sample;
+    }
+  }
+
+  // the conversion of samples is decided here once for the whole file.
+  SetDownmix(DownmixOptions());
+}
+
+bool WavHeader::IsValidWav() const {
+  if (!is_riff_wave_ || !chunk_index_.fmt.present ||
+      !chunk_index_.data.present) {
     return false;
   }
 
   // check for valid block align values.
-  auto block_align = GetFormatChunkHeader().block_align;
-  auto number_of_channels = GetFormatChunkHeader().number_of_channels;
-  auto bits_per_sample = GetFormatChunkHeader().bits_per_sample;
+  auto block_align = format_.block_align;
+  auto number_of_channels = format_.number_of_channels;
+  auto bits_per_sample = format_.bits_per_sample;
   // bits-width in some wav file are not divisable by 8, like 12, 20 and ...
   // the cases, although uncommon, should be scaled up to 8 bits divided width.
   // for example, to store a 12-bits sample, 16-bits are needed and 24-bits,
   // for 20-bits sample.
   unsigned int sample_bits_ceiling = ceil((float)bits_per_sample / 8) * 8;
-  if (block_align * 8 != sample_bits_ceiling * number_of_channels) {
+  if (block_align == 0 ||
+      block_align * 8 != sample_bits_ceiling * number_of_channels) {
     // block align = sample_width(in bytes) * number_of_channels
     printf("invalid block align, %d, %d, %d\n", block_align, sample_bits_ceiling, number_of_channels);
     return false;
   }
 
-  // TODO: we need more checks, like presence of data, chunks size and etc.
+  // TODO: we need more checks, like chunks size and etc.
   return true;
 }
 
-int WavHeader::FindFormatChunkHeader() {
-  input_.seekg(sizeof(RiffChunk));
-
-  do {
-    auto chunk = CastBytes<ChunkHeader>(input_);
-    if (!input_) {
-      // stream not long enough or an internal error in stream.
-      return -1;
-    }
-    if (chunk.id == FMT_CHUNK_ID) {
-      return (int)input_.tellg() - sizeof(chunk);
-    }
-    input_.seekg((int)input_.tellg() + chunk.size);
-  } while (true);
-  return -1;
+const WavHeader::FmtChunk& WavHeader::GetFormatChunkHeader() const {
+  return fmt_chunk_;
 }
 
-WavHeader::FmtChunk WavHeader::GetFormatChunkHeader() {
-  WavHeader::FmtChunk result;
-  auto fmt_pos = FindFormatChunkHeader();
-  if (fmt_pos >= 0) {
-    input_.seekg(fmt_pos);
-    result = CastBytes<FmtChunk>(input_);
-  }
-  return result;
+const WavHeader::Format& WavHeader::GetFormat() const {
+  return format_;
 }
 
-int WavHeader::FindDataChunkHeader() {
-  input_.seekg(sizeof(RiffChunk));
-  do {
-    auto chunk = CastBytes<ChunkHeader>(input_);
-    if (!input_) {
-      // stream not long enough or an internal error in stream.
-      return -1;
-    }
+const WavHeader::ChunkIndex& WavHeader::GetChunkIndex() const {
+  return chunk_index_;
+}
 
-    if (chunk.id == DATA_CHUNK_ID) {
-      return (int)input_.tellg() - sizeof(chunk);
-    }
-    input_.seekg((int)input_.tellg() + chunk.size);
-  } while (true);
-  return -1;
+uint64_t WavHeader::GetDataSize() const {
+  return chunk_index_.data.size;
 }
 
-size_t WavHeader::GetDataSize() {
-  auto data_pos = FindDataChunkHeader();
-  if (data_pos >= 0) {
-    input_.seekg(data_pos);
-    auto result = CastBytes<DataChunk>(input_);
-    return result.chunk_header.size;
+uint64_t WavHeader::GetNumberOfSamples() const {
+  if (format_.block_align == 0) {
+    return 0;
   }
-  return 0;
+  return GetDataSize() / format_.block_align;
 }
 
-size_t WavHeader::GetNumberOfSamples() {
-  auto block_align = GetFormatChunkHeader().block_align;
-  return GetDataSize() / block_align;
+bool WavHeader::IsDataSizeKnown() const {
+  return chunk_index_.data.size != kUnknownDataSize;
 }
 
-int WavHeader::GetDataIndex() {
-  auto data_pos = FindDataChunkHeader();
-  if (data_pos >= 0) {
-    return data_pos + offsetof(DataChunk, data);
-  }
-  return 0;
+uint64_t WavHeader::GetDataIndex() const {
+  return data_index_;
 }
 
-uint16_t map16(uint16_t val, unsigned int val_bits) {
-  if (val == 0) return 0;
-  int16_t out_minimum = -0x7fff - 1; 
-  int16_t out_maximum = 0x7fff; 
-  int16_t in_minimum = - (1 << (val_bits - 1));
-  int16_t in_maximum = (1 << (val_bits - 1)) - 1;
-
-  double pos = (double)(val - in_minimum) / (double)( in_maximum - in_minimum);
-  auto result = ((double)out_maximum - (double)out_minimum) * pos +
-      (double)out_minimum;
-  return (uint16_t) result;
+uint16_t WavHeader::GetAudioFormat() const {
+  return format_.audio_format;
 }
 
-uint32_t map32(uint32_t val, unsigned int val_bits) {
-  if (val == 0) return 0;
-  const int32_t out_minimum = -0x7fffffff - 1;
-  const int32_t out_maximum = 0x7fffffff;
-  int32_t in_minimum = - (1 << (val_bits - 1));
-  int32_t in_maximum = (1 << (val_bits - 1)) - 1;
-
-  double pos = (double)(val - in_minimum) / (double)( in_maximum - in_minimum);
-  auto result = ((double)out_maximum - (double)out_minimum) * pos +
-      (double)out_minimum;
-  return (uint32_t) result;
+const PCMKernel& WavHeader::GetPCMKernel() const {
+  return pcm_kernel_;
 }
 
-uint16_t ScaleAmplitude8(uint8_t val) {
-  // 8-bit PCM is unsigned with the center point of 128.
-  return map16(val - 128, 8);
-}
+void WavHeader::SetDownmix(const DownmixOptions& options) {
+  auto number_of_channels = format_.number_of_channels;
+  pcm_kernel_ = ResolvePCMKernel(format_.audio_format, format_.bits_per_sample,
+                                 format_.valid_bits_per_sample,
+                                 number_of_channels);
+  downmix_ = DownmixMatrix();
+  if (number_of_channels == 0 || number_of_channels > kMaxDownmixChannels) {
+    return;
+  }
+  if (options.matrix.input_channels == number_of_channels) {
+    downmix_ = options.matrix;
+  } else if (number_of_channels > options.output_channels) {
+    downmix_ = MakeDownmixMatrix(format_.channel_mask, number_of_channels,
+                                 options.output_channels);
+  } else {
+    return;
+  }
 
-uint16_t ScaleAmplitude16(uint16_t val, unsigned int bits_per_sample) {
-  unsigned int sample_bits_ceiling = ceil((float)bits_per_sample / 8) * 8;
-  // clear garbage bits in the padded bytes.
-  if (bits_per_sample < 16) {
-    val &= (1 << bits_per_sample) - 1; 
+  // blocks have no padding, so the channels of a block are converted like
+  // consecutive samples of a mono file.
+  input_kernel_ = ResolvePCMKernel(format_.audio_format,
+                                   format_.bits_per_sample,
+                                   format_.valid_bits_per_sample, 1);
+  if (!input_kernel_.IsSupported()) {
+    pcm_kernel_ = input_kernel_;
+    downmix_ = DownmixMatrix();
+    return;
   }
-  uint16_t out_val = 0;
-  for (unsigned int b = 0; b < bits_per_sample; b++) {
-    out_val |= (val & (1 << b)) ? 1 << b : 0;
+  // lame takes float samples in [-1, 1]. integer samples are converted to
+  // full scale, the gains scale them down as they are mixed.
+  float scale = 1;
+  if (input_kernel_.sample_type == SampleType::kInt16) {
+    scale = 1.0f / 32768;
+  } else if (input_kernel_.sample_type == SampleType::kInt32) {
+    scale = 1.0f / 2147483648.0f;
   }
-  // convert value to 2nd compliment value.
-  if ((bits_per_sample < sample_bits_ceiling) &&
-      ((out_val & (1 << (bits_per_sample - 1))) != 0)) {
-    out_val -= 1 << (bits_per_sample);
+  for (unsigned int c = 0; c < number_of_channels; c++) {
+    downmix_.gains[0][c] *= scale;
+    downmix_.gains[1][c] *= scale;
   }
-  return map16(out_val, bits_per_sample);
+  pcm_kernel_ = input_kernel_;
+  pcm_kernel_.channels = number_of_channels;
+  pcm_kernel_.sample_type = SampleType::kFloat;
+  pcm_kernel_.native = false;
 }
 
-uint32_t ScaleAmplitude32(uint32_t val, unsigned int bits_per_sample) {
-  unsigned int sample_bits_ceiling = ceil((float)bits_per_sample / 8) * 8;
-  // clear garbage bits in the padded bytes.
-  if (bits_per_sample < 32) {
-    val &= (1 << bits_per_sample) - 1; 
+unsigned int WavHeader::GetOutputChannels() const {
+  return downmix_.input_channels ? downmix_.output_channels
+                                 : format_.number_of_channels;
+}
+
+bool WavHeader::NextPCMSpan() {
+  auto block_align = format_.block_align;
+  auto number_of_samples = GetNumberOfSamples();
+  if (!pcm_started_) {
+    // the source is only fetched from after this seek, which keeps the span
+    // returned by it valid between calls.
+    input_.Seek(GetDataIndex());
+    pcm_started_ = true;
   }
-  uint32_t out_val = 0;
-  for (unsigned int b = 0; b < bits_per_sample; b++) {
-    out_val |= (val & (1 << b)) ? 1 << b : 0;
+  if (frames_read_ >= number_of_samples) {
+    return false;
+  }
+  if (pcm_span_next_ < pcm_span_frames_) {
+    return true;
   }
-  // convert value to 2nd compliment value.
-  if ((bits_per_sample < sample_bits_ceiling) &&
-      ((out_val & (1 << (bits_per_sample - 1))) != 0)) {
-    out_val -= 1 << (bits_per_sample);
+
+  // every channel of a block is converted at once and data chunk is fetched
+  // in large spans of whole blocks, so each byte of it is read exactly one
+  // time and a span never splits a frame. memory-mapped sources hand out the
+  // span without copying it.
+  auto frames_to_read = (size_t)std::min<uint64_t>(
+      kPCMBufferSize / block_align, number_of_samples - frames_read_);
+  pcm_span_frames_ = input_.Fetch(frames_to_read * block_align,
+                                  &pcm_span_) / block_align;
+  pcm_span_next_ = 0;
+  if (pcm_span_frames_ == 0) {
+    // data chunk is truncated, there is nothing more to read.
+    frames_read_ = number_of_samples;
+    return false;
   }
-  return map32(out_val, bits_per_sample);
+  return true;
 }
 
-uint16_t WavHeader::GetAudioFormat() {
-  auto fmt_chunk = GetFormatChunkHeader();
-  if (fmt_chunk.format_tag != WAVE_FORMAT_EXTENSIBLE) {
-    return fmt_chunk.format_tag;
+void WavHeader::DownmixBlocks(const uint8_t* blocks, size_t number_of_blocks,
+                              float* out) {
+  const auto& kernels = *input_kernel_.kernels;
+  auto block_align = format_.block_align;
+  auto number_of_channels = downmix_.input_channels;
+  auto output_channels = downmix_.output_channels;
+  downmix_tile_.Reserve(kDownmixTileFrames * number_of_channels *
+                        GetSampleSize(input_kernel_.sample_type));
+  auto tile = downmix_tile_.GetData();
+
+  for (size_t done = 0; done < number_of_blocks;) {
+    auto frames = std::min(kDownmixTileFrames, number_of_blocks - done);
+    input_kernel_.Convert(blocks + done * block_align,
+                          frames * number_of_channels, tile);
+    auto tile_out = out + done * output_channels;
+    switch (input_kernel_.sample_type) {
+      case SampleType::kInt16:
+        kernels.downmix_s16((const int16_t*)tile, tile_out, frames, downmix_);
+        break;
+      case SampleType::kInt32:
+        kernels.downmix_s32((const int32_t*)tile, tile_out, frames, downmix_);
+        break;
+      case SampleType::kFloat:
+        kernels.downmix_f32((const float*)tile, tile_out, frames, downmix_);
+        break;
+      case SampleType::kDouble:
+        kernels.downmix_f64((const double*)tile, tile_out, frames, downmix_);
+        break;
+    }
+    done += frames;
   }
-  return  fmt_chunk.audio_format;
 }
 
-std::unique_ptr<std::string> WavHeader::ReadPCMData(unsigned int channel) {
-  auto data_index = GetDataIndex();
-  auto number_of_samples = GetNumberOfSamples();
-  auto block_align = GetFormatChunkHeader().block_align;
-  auto bits_per_sample = GetFormatChunkHeader().bits_per_sample;
+size_t WavHeader::ReadPCMFrames(void* samples, size_t number_of_frames) {
+  auto block_align = format_.block_align;
+  auto number_of_channels = GetOutputChannels();
+  auto sample_size = GetSampleSize(pcm_kernel_.sample_type);
+  if (!pcm_kernel_.IsSupported()) {
+    return 0;
+  }
 
-  // bits-width in some wav file are not divisable by 8, like 12, 20 and ...
-  // the cases, although uncommon, should be scaled up to 8 bits divided width.
-  // for example, to store a 12-bits sample, 16-bits are needed and 24-bits,
-  // for 20-bits sample.
-  unsigned int sample_bits_ceiling = ceil((float)bits_per_sample / 8) * 8;
+  size_t frames_done = 0;
+  while (frames_done < number_of_frames && NextPCMSpan()) {
+    auto frames = std::min(number_of_frames - frames_done,
+                           pcm_span_frames_ - pcm_span_next_);
+    auto blocks = pcm_span_ + pcm_span_next_ * block_align;
+    auto out = (char*)samples + frames_done * number_of_channels *
+               sample_size;
+    if (downmix_.input_channels) {
+      DownmixBlocks(blocks, frames, (float*)out);
+    } else {
+      pcm_kernel_.Convert(blocks, frames, out);
+    }
+    pcm_span_next_ += frames;
+    frames_read_ += frames;
+    frames_done += frames;
+  }
+
+  return frames_done;
+}
 
-  auto number_of_channels = GetFormatChunkHeader().number_of_channels;
-  auto result = new std::string();
-  if (number_of_channels == 1 && channel > 0) {
-    // unsupported format.
-    return std::unique_ptr<std::string>(result);
+size_t WavHeader::FetchPCMFrames(size_t number_of_frames,
+                                 const void** samples) {
+  auto block_align = format_.block_align;
+  auto sample_size = GetSampleSize(pcm_kernel_.sample_type);
+  if (!pcm_kernel_.IsSupported()) {
+    return 0;
   }
 
-  // alocating space for the output buffer.
-  // we use std::string as an output buffer, because it is really easy to
-  // resize it and thus allocate buffer, without being worry of memory leaks.
-  auto buffer_size = number_of_samples;
-  if (sample_bits_ceiling <= 16) {
-    // each sample will be stored in a short int.
-    buffer_size *= 2;
-  } else {
-    // each sample will be stored in an int.
-    buffer_size *= 4;
-  }
-  result->resize(buffer_size);
-
-  // read pcm data.
-  input_.seekg(data_index);
-  for (size_t i = 0; i < number_of_samples; i++) {
-    // read one block.
-    // each block contains a sample for each channel which are interleaved.
-    // CAUTION: we are allocating a buffer based on an input value (block_align)
-    // we should check block_align before hand. a malicously crafted wav file
-    // can cause potential problems here. that is why in IsValidWav() function,
-    // we have to check for valid values for block_align.
-    char block[block_align];
-    std::memset(block, 0, block_align);
-    input_.read(block, block_align);
-    // if (i < 5) {
-    //   HEX_DUMP((const unsigned char *)block, 8);
-    // }
-    if (sample_bits_ceiling == 8) {
-      // 8-bits width samples can be read into a byte.
-      uint8_t unscaled_value = ((uint8_t *) block)[(channel == 0) ? 0 : 1];
-      auto out_offset = &((uint16_t *) result->c_str())[i];
-      *out_offset = ScaleAmplitude8(unscaled_value);
+  if (pcm_kernel_.native && NextPCMSpan()) {
+    // lame reads the samples through typed pointers, so they are handed out
+    // in place only if they are aligned to their size. it is decided per
+    // span, spans of a mapping are all aligned the same as data chunk.
+    auto span = pcm_span_ + pcm_span_next_ * block_align;
+    if ((uintptr_t)span % sample_size == 0) {
+      auto frames = std::min(number_of_frames,
+                             pcm_span_frames_ - pcm_span_next_);
+      pcm_span_next_ += frames;
+      frames_read_ += frames;
+      *samples = span;
+      return frames;
     }
-    else if (sample_bits_ceiling == 16) {
-      // 16-bits width samples can be read into a short int
-      uint16_t unscaled_value = ((uint16_t *) block)[(channel == 0) ? 0 : 1];
-      auto out_offset = &((uint16_t *) result->c_str())[i];
-      *out_offset = ScaleAmplitude16(unscaled_value, bits_per_sample);
+  }
+
+  pcm_buffer_.Reserve(number_of_frames * GetOutputChannels() * sample_size);
+  *samples = pcm_buffer_.GetData();
+  return ReadPCMFrames(pcm_buffer_.GetData(), number_of_frames);
+}
+
+bool WavHeader::SeekPCMFrame(uint64_t frame) {
+  if (frame > GetNumberOfSamples() ||
+      !input_.Seek(GetDataIndex() + frame * format_.block_align)) {
+    return false;
+  }
+  pcm_started_ = true;
+  frames_read_ = frame;
+  // the current span does not belong to the new position any more.
+  pcm_span_frames_ = 0;
+  pcm_span_next_ = 0;
+  return true;
+}
+
+// ForwardOnlySource reads a buffer like a pipe would be read, it has no
+// known size and cannot seek backwards.
+class ForwardOnlySource : public Source {
+public:
+  ForwardOnlySource(const uint8_t* data, uint64_t size)
+      : memory_(data, size) {}
+
+  size_t Read(void* buffer, size_t size) override {
+    return memory_.Read(buffer, size);
+  }
+
+  size_t Fetch(size_t size, const uint8_t** data) override {
+    return memory_.Fetch(size, data);
+  }
+
+  bool Seek(uint64_t offset) override {
+    return offset >= memory_.Tell() && memory_.Seek(offset);
+  }
+
+  uint64_t Tell() const override {
+    return memory_.Tell();
+  }
+
+  uint64_t GetSize() const override {
+    return 0;
+  }
+
+private:
+  MemorySource memory_;
+};
+
+// @desc - appends a little-endian integer to a file built in memory.
+static void AppendInteger(std::vector<uint8_t>& bytes, uint64_t value,
+                          size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    bytes.push_back((uint8_t)(value >> (i * 8)));
+  }
+}
+
+// @desc - builds a 16-bits mono wav file of 100 frames.
+// @param riff_size - size in the riff header.
+// @param data_size - size in the header of data chunk.
+// @param list_after - adds an empty LIST chunk after data chunk. data chunk
+//        has no samples then if data_size is 0.
+// @return std::vector<uint8_t> - the file.
+static std::vector<uint8_t> MakeTestWav(uint32_t riff_size,
+                                        uint32_t data_size, bool list_after) {
+  const size_t kFrames = 100;
+  std::vector<uint8_t> bytes;
+  AppendInteger(bytes, RIFF_CHUNK_ID, 4);
+  AppendInteger(bytes, riff_size, 4);
+  AppendInteger(bytes, RIFF_FORMAT_WAVE, 4);
+  AppendInteger(bytes, FMT_CHUNK_ID, 4);
+  AppendInteger(bytes, 16, 4);
+  AppendInteger(bytes, WAVE_FORMAT_PCM, 2);
+  AppendInteger(bytes, 1, 2);
+  AppendInteger(bytes, 8000, 4);
+  AppendInteger(bytes, 16000, 4);
+  AppendInteger(bytes, 2, 2);
+  AppendInteger(bytes, 16, 2);
+  AppendInteger(bytes, DATA_CHUNK_ID, 4);
+  AppendInteger(bytes, data_size, 4);
+  if (data_size != 0 || !list_after) {
+    for (size_t i = 0; i < kFrames; i++) {
+      AppendInteger(bytes, i * 300, 2);
     }
-    else if (sample_bits_ceiling == 24 || sample_bits_ceiling == 32) {
-      // larger samples can be read into an int.
-      uint32_t unscaled_value = 0;
-      if (channel == 0) {
-        unscaled_value = ((uint32_t *) block)[0];
-      } else {
-        unscaled_value = ((uint32_t *)((uint8_t *)block + block_align / 2))[0];
+  }
+  if (list_after) {
+    AppendInteger(bytes, LIST_CHUNK_ID, 4);
+    AppendInteger(bytes, 4, 4);
+    AppendInteger(bytes, 0x4f464e49, 4);
+  }
+  return bytes;
+}
+
+// @desc - builds the RF64 or BW64 version of MakeTestWav(), with 32-bit
+//         sizes of 0xFFFFFFFF and their real sizes in a ds64 chunk.
+// @param riff_id - RF64_CHUNK_ID or BW64_CHUNK_ID.
+// @param data_size - size of data in the ds64 chunk, 0 while a file is
+//        still being written.
+// @param list_after - adds an empty LIST chunk after data chunk.
+// @return std::vector<uint8_t> - the file.
+static std::vector<uint8_t> MakeTestRF64(uint32_t riff_id, uint64_t data_size,
+                                         bool list_after) {
+  auto wav = MakeTestWav(STREAMING_SIZE_MAX, STREAMING_SIZE_MAX, list_after);
+  std::vector<uint8_t> ds64;
+  AppendInteger(ds64, DS64_CHUNK_ID, 4);
+  AppendInteger(ds64, 28, 4);
+  AppendInteger(ds64, wav.size() + 36 - 8, 8);
+  AppendInteger(ds64, data_size, 8);
+  AppendInteger(ds64, data_size / 2, 8);
+  AppendInteger(ds64, 0, 4);
+  wav.insert(wav.begin() + sizeof(WavHeader::RiffChunk), ds64.begin(),
+             ds64.end());
+  std::memcpy(wav.data(), &riff_id, sizeof(riff_id));
+  return wav;
+}
+
+// @desc - parses a file and reads all of its frames.
+// @return bool - true if the data size, the frames and the LIST chunk are
+//         as expected.
+static bool CheckTestWav(const std::vector<uint8_t>& bytes, bool seekable,
+                         uint64_t data_size, uint64_t frames,
+                         bool list_found) {
+  MemorySource memory(bytes.data(), bytes.size());
+  ForwardOnlySource forward_only(bytes.data(), bytes.size());
+  Source& input = seekable ? (Source&)memory : (Source&)forward_only;
+  WavHeader header(input);
+  if (!header.IsValidWav() || header.GetDataSize() != data_size ||
+      header.GetChunkIndex().list.present != list_found) {
+    return false;
+  }
+  int16_t samples[64];
+  uint64_t frames_read = 0;
+  size_t read;
+  while ((read = header.ReadPCMFrames(samples, std::size(samples))) > 0) {
+    for (size_t i = 0; i < read; i++) {
+      if (samples[i] != (int16_t)((frames_read + i) * 300)) {
+        return false;
       }
-      auto out_offset = &((uint32_t *) result->c_str())[i];
-      *out_offset = ScaleAmplitude32(unscaled_value, bits_per_sample);
     }
+    frames_read += read;
   }
+  return frames_read == frames;
+}
 
-  return std::unique_ptr<std::string>(result);
+bool ValidateWavHeaders() {
+  const uint32_t kDataSize = 200;
+  // riff size of a file whose data chunk ends it.
+  const uint32_t kRiffSize = 36 + kDataSize;
+  return
+      // sizes that are filled in.
+      CheckTestWav(MakeTestWav(kRiffSize, kDataSize, false), true,
+                   kDataSize, 100, false) &&
+      CheckTestWav(MakeTestWav(kRiffSize + 12, kDataSize, true), true,
+                   kDataSize, 100, true) &&
+      // streaming writers, the rest of input is data.
+      CheckTestWav(MakeTestWav(0, 0, false), true, kDataSize, 100, false) &&
+      CheckTestWav(MakeTestWav(STREAMING_SIZE_MAX, STREAMING_SIZE_MAX,
+                               false), true, kDataSize, 100, false) &&
+      CheckTestWav(MakeTestWav(kRiffSize, STREAMING_SIZE_MAX, false), true,
+                   kDataSize, 100, false) &&
+      CheckTestWav(MakeTestWav(36, 0, false), true, kDataSize, 100, false) &&
+      // an empty data chunk that other chunks follow.
+      CheckTestWav(MakeTestWav(48, 0, true), true, 0, 0, true) &&
+      // a pipe cannot look past data chunk, and its size is unknown.
+      CheckTestWav(MakeTestWav(0, 0, false), false,
+                   WavHeader::kUnknownDataSize, 100, false) &&
+      CheckTestWav(MakeTestWav(kRiffSize, kDataSize, false), false,
+                   kDataSize, 100, false) &&
+      // 64-bit sizes, and an RF64 file that is still being written.
+      CheckTestWav(MakeTestRF64(RF64_CHUNK_ID, kDataSize, true), true,
+                   kDataSize, 100, true) &&
+      CheckTestWav(MakeTestRF64(BW64_CHUNK_ID, kDataSize, true), true,
+                   kDataSize, 100, true) &&
+      CheckTestWav(MakeTestRF64(RF64_CHUNK_ID, 0, false), true, kDataSize,
+                   100, false) &&
+      CheckTestWav(MakeTestRF64(RF64_CHUNK_ID, kDataSize, false), false,
+                   kDataSize, 100, false);
 }
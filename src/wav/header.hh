@@ -2,9 +2,11 @@
 #define WASHMYWAVES_WAV_HEADER_H__
 
 #include <cstdint>
-#include <istream>
-#include <string>
-#include <memory>
+
+#include "io/source.hh"
+#include "utils/buffer_pool.hh"
+#include "wav/downmix.hh"
+#include "wav/kernel_table.hh"
 
 #define WAVE_FORMAT_PCM        0x0001 
 #define WAVE_FORMAT_IEEE_FLOAT 0x0003 
@@ -36,6 +38,9 @@ public:
     uint16_t block_align;
     uint16_t bits_per_sample;
     // the rest of struct mwmbers are only present in extensible wav format.
+    // the sub format guid is the format code followed by the same 14 bytes
+    // for every format that has a code.
+    uint16_t cb_size;
     uint16_t valid_bits_per_sample;
     uint32_t channel_mask;
     union {
@@ -49,47 +54,230 @@ public:
     uint8_t data[0];
   };
 
-  WavHeader(std::istream& input);
+  // ds64 chunk comes first in RF64 and BW64 files, which are wav files that
+  // can be larger than 4GiB. chunks too large for their 32-bit size leave it
+  // 0xFFFFFFFF, and their 64-bit size is given here. the size of data chunk
+  // has a field of its own and other chunks are listed in a table, which
+  // follows the chunk.
+  // https://tech.ebu.ch/docs/tech/tech3306v1_1.pdf
+  struct Ds64Chunk {
+    ChunkHeader chunk_header;
+    uint64_t riff_size;
+    uint64_t data_size;
+    uint64_t sample_count;
+    uint32_t table_length;
+  };
+
+  struct Ds64TableEntry {
+    uint32_t id;
+    uint32_t size_low;
+    uint32_t size_high;
+  };
+
+  // ChunkLocation is the position of a chunk in the input.
+  struct ChunkLocation {
+    bool present = false;
+    // offset of the chunk header from the beginning of input.
+    uint64_t offset = 0;
+    // size of the chunk, without its header.
+    uint64_t size = 0;
+  };
+
+  // ChunkIndex holds the chunks of a wav file that are of interest. only the
+  // first chunk of each type is recorded.
+  struct ChunkIndex {
+    ChunkLocation ds64;
+    ChunkLocation fmt;
+    ChunkLocation fact;
+    ChunkLocation data;
+    ChunkLocation list;
+  };
+
+  // Format is the resolved description of the samples in data chunk.
+  struct Format {
+    // WAVE_FORMAT_PCM, WAVE_FORMAT_..., sub format of extensible files.
+    uint16_t audio_format;
+    uint16_t number_of_channels;
+    uint32_t sample_rate;
+    uint16_t block_align;
+    // width of the container that each sample is stored in.
+    uint16_t bits_per_sample;
+    // number of bits that are actually used in each container.
+    uint16_t valid_bits_per_sample;
+    // speaker positions of the channels, 0 if the file does not tell.
+    uint32_t channel_mask;
+  };
+
+  // size of data chunk if it runs to the end of an input of unknown size,
+  // like a wav stream written to a pipe.
+  static const uint64_t kUnknownDataSize = UINT64_MAX;
+
+  // @desc - parses the chunks of a wav file. the input is scanned once here
+  //         and every getter is served from what is found.
+  // @param input - the source to parse, it must outlive the object.
+  WavHeader(Source& input);
 
-  // @desc - checks if the input stream is a valid wav file.
+  // @desc - describes raw pcm data, which has no header. the input starts
+  //         with the first sample and data runs to its end.
+  // @param input - the samples, it must outlive the object.
+  // @param format - format of the samples. block_align and
+  //        valid_bits_per_sample are worked out if they are 0.
+  WavHeader(Source& input, const Format& format);
+
+  // @desc - checks if the input is a valid wav file.
   // @return bool - true is a valid wav file is opened.
-  bool IsValidWav();
+  bool IsValidWav() const;
 
   // @desc - returns format chuck header of wav files.
   // @return FmtChunk
-  FmtChunk GetFormatChunkHeader();
+  const FmtChunk& GetFormatChunkHeader() const;
+
+  // @desc - returns the resolved format of samples.
+  // @return Format
+  const Format& GetFormat() const;
 
-  // @desc - used to determine data size in data chuck.
-  // return size_t - size of data.
-  size_t GetDataSize();
+  // @desc - returns positions of ds64, fmt, fact, data and LIST chunks.
+  // @return ChunkIndex
+  const ChunkIndex& GetChunkIndex() const;
+
+  // @desc - used to determine data size in data chuck. streaming writers
+  //         cannot come back to fill in the size, and leave it 0 or
+  //         0xFFFFFFFF. data chunk then runs to the end of input. a size of
+  //         0 in a seekable input is only taken that way if data is the last
+  //         chunk by the riff size, otherwise data chunk is empty.
+  // return uint64_t - size of data, kUnknownDataSize if it runs to the end
+  //        of an input of unknown size.
+  uint64_t GetDataSize() const;
 
   // @desc - used to determine number of samples in data chuck.
-  // return size_t - number of samples.
-  size_t GetNumberOfSamples();
+  // return uint64_t - number of samples, a huge number if the data size is
+  //        unknown. reading stops at the end of input either way.
+  uint64_t GetNumberOfSamples() const;
+
+  // @desc - checks if the number of samples is known before they are read.
+  // @return bool - false for wav streams of unknown length.
+  bool IsDataSizeKnown() const;
 
-  // @desc - returns the index of raw data in the input stream. 
-  // return int - index of raw data, on error 0.
-  int GetDataIndex();
+  // @desc - returns the index of raw data in the input stream.
+  // return uint64_t - index of raw data, on error 0.
+  uint64_t GetDataIndex() const;
 
   // @desc - returns the the format of audio data.
   // return uint16_t - can be WAVE_FORMAT_PCM, WAVE_FORMAT_...
-  uint16_t GetAudioFormat();
+  uint16_t GetAudioFormat() const;
 
-  // @desc - returns the aplitude-scaled pcm data.  
-  // @param channel - can be 0 (for left channel) or 1 (for right channel).
-  // @return std::unique_ptr<std::string> - a buffer containing pcm data.
-  std::unique_ptr<std::string> ReadPCMData(unsigned int channel);
+  // @desc - returns the kernel that converts samples of this file. if the
+  //         file is mixed down, sample_type is the float type of the mixed
+  //         frames and the rest describes the samples of the file.
+  // @return PCMKernel - unsupported if the format is not supported.
+  const PCMKernel& GetPCMKernel() const;
+
+  // @desc - decides how the channels of this file are mixed down. files
+  //         with more than 2 channels are mixed to stereo with the standard
+  //         matrix of their layout until it is called. it has to be called
+  //         before the first frame is read.
+  // @param options - the downmix options.
+  void SetDownmix(const DownmixOptions& options);
+
+  // @desc - returns number of channels of the frames returned by
+  //         ReadPCMFrames() and FetchPCMFrames().
+  // @return unsigned int - channels of the file, unless it is mixed down.
+  unsigned int GetOutputChannels() const;
+
+  // @desc - reads the next frames of aplitude-scaled pcm data. the first call
+  //         starts from the beginning of data chunk and each call continues
+  //         where the previous one stopped. samples of all channels are read
+  //         in one pass and stored interleaved, in the sample type of
+  //         GetPCMKernel(). files that are mixed down are mixed in the same
+  //         pass, a few hundred frames at a time.
+  // @param samples - buffer for at least number_of_frames *
+  //        GetOutputChannels() samples.
+  // @param number_of_frames - maximum number of frames to read.
+  // @return size_t - number of frames read, 0 at the end of data.
+  size_t ReadPCMFrames(void* samples, size_t number_of_frames);
+
+  // @desc - same as ReadPCMFrames(), but returns the frames instead of
+  //         copying them. if the file is in a native format of lame, the
+  //         frames are handed out from the input as they are, otherwise
+  //         they are converted into a buffer owned by WavHeader. either way
+  //         the pointer stays valid until the next call.
+  // @param number_of_frames - maximum number of frames to return.
+  // @param samples - set to the interleaved samples, in the sample type of
+  //        GetPCMKernel().
+  // @return size_t - number of frames returned, 0 at the end of data.
+  size_t FetchPCMFrames(size_t number_of_frames, const void** samples);
+
+  // @desc - moves the position of ReadPCMFrames() and FetchPCMFrames() to a
+  //         frame of data chunk. it needs a seekable input.
+  // @param frame - index of the frame to continue from.
+  // @return bool - true on success.
+  bool SeekPCMFrame(uint64_t frame);
 
 private:
-  std::istream& input_;
+  // maximum size of the spans that data chunk is fetched in by
+  // ReadPCMFrames().
+  static const size_t kPCMBufferSize = 1 << 20;
+  // number of frames converted at a time before they are mixed down. a tile
+  // stays in the l1 cache between converting and mixing it.
+  static constexpr size_t kDownmixTileFrames = 256;
+
+  Source& input_;
+  // true if the input starts with a riff header of wave format.
+  bool is_riff_wave_ = false;
+  // true if it is an RF64 or BW64 header, whose sizes are in ds64 chunk.
+  bool is_rf64_ = false;
+  ChunkIndex chunk_index_;
+  // offset of the first sample from the beginning of input.
+  uint64_t data_index_ = 0;
+  FmtChunk fmt_chunk_;
+  Format format_;
+  PCMKernel pcm_kernel_;
+  // matrix that frames are mixed down with, scaled to the sample type of
+  // input_kernel_. input_channels is 0 if they are not mixed.
+  DownmixMatrix downmix_;
+  // kernel that converts the samples of a file that is mixed down, one
+  // channel at a time.
+  PCMKernel input_kernel_;
+  // converted frames of the tile being mixed down.
+  PooledBuffer downmix_tile_;
+  // true once ReadPCMFrames() has moved the input to data chunk.
+  bool pcm_started_ = false;
+  // number of frames already returned by ReadPCMFrames().
+  uint64_t frames_read_ = 0;
+  // raw blocks of data chunk, fetched in spans of up to kPCMBufferSize bytes.
+  const uint8_t* pcm_span_ = nullptr;
+  // number of blocks in pcm_span_ and index of the next one to convert.
+  size_t pcm_span_frames_ = 0;
+  size_t pcm_span_next_ = 0;
+  // frames converted by FetchPCMFrames() if they cannot be handed out as
+  // they are. pooled buffers are aligned to fit every sample type.
+  PooledBuffer pcm_buffer_;
 
-  // @desc - finds the index of fmt chunk header.
-  // @return int - index of fmt chunk header or -1 on error. 
-  int FindFormatChunkHeader();
+  // @desc - moves the input to data chunk on the first call and fetches the
+  //         next span of it once the current one is used up.
+  // @return bool - false if there are no more frames.
+  bool NextPCMSpan();
 
-  // @desc - finds the index of data chunk header.
-  // @return int - index of data chunk header or -1 on error. 
-  int FindDataChunkHeader();
+  // @desc - converts raw blocks of data chunk and mixes them down, tile by
+  //         tile.
+  // @param blocks - the blocks.
+  // @param number_of_blocks - number of blocks to mix.
+  // @param out - output buffer of number_of_blocks * GetOutputChannels()
+  //        samples.
+  void DownmixBlocks(const uint8_t* blocks, size_t number_of_blocks,
+                     float* out);
+
+  // @desc - scans the chunks of input and fills chunk_index_, fmt_chunk_ and
+  //         format_. chunks are visited in order and the input only moves
+  //         forward, the scan stops at data chunk if input size is unknown.
+  void Parse();
 };
 
+// @desc - parses small wav and RF64 files built in memory, with data sizes
+//         filled in, left 0 or 0xFFFFFFFF, and from seekable and
+//         forward-only inputs, and checks the data size and the frames read
+//         from each.
+// @return bool - true if all results are as expected.
+bool ValidateWavHeaders();
+
 #endif // WASHMYWAVES_WAV_HEADER_H__
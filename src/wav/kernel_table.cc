@@ -0,0 +1,161 @@
+#include <array>
+#include <cstring>
+#include <utility>
+
+#include "wav/header.hh"
+#include "wav/kernels.hh"
+#include "wav/kernel_table.hh"
+
+// maximum number of channels that lame takes.
+const unsigned int kMaxChannels = 2;
+// maximum width of integer samples.
+const unsigned int kMaxBits = 32;
+
+// SampleCodec is the function of SampleKernels that converts the samples of
+// a format.
+enum class SampleCodec {
+  kU8,
+  kS16,
+  kS24,
+  kS32,
+  kF32,
+  kF64,
+  kAlaw,
+  kMulaw,
+};
+
+template <SampleCodec Codec, unsigned int Channels, unsigned int ValidBits>
+static void ConvertBlocks(const SampleKernels& kernels,
+                          const uint8_t* blocks, size_t number_of_blocks,
+                          void* out) {
+  // blocks have no padding, so the samples of consecutive blocks are simply
+  // consecutive samples.
+  const size_t number_of_samples = number_of_blocks * Channels;
+  if constexpr (Codec == SampleCodec::kU8) {
+    kernels.convert_u8(blocks, (int16_t*)out, number_of_samples);
+  } else if constexpr (Codec == SampleCodec::kS16) {
+    std::get<ValidBits>(kernels.convert_s16)(blocks, (int16_t*)out,
+                                             number_of_samples);
+  } else if constexpr (Codec == SampleCodec::kS24) {
+    std::get<ValidBits>(kernels.convert_s24)(blocks, (int32_t*)out,
+                                             number_of_samples);
+  } else if constexpr (Codec == SampleCodec::kS32) {
+    std::get<ValidBits>(kernels.convert_s32)(blocks, (int32_t*)out,
+                                             number_of_samples);
+  } else if constexpr (Codec == SampleCodec::kF32) {
+    kernels.convert_f32(blocks, (float*)out, number_of_samples);
+  } else if constexpr (Codec == SampleCodec::kF64) {
+    // lame takes ieee doubles as they are.
+    memcpy(out, blocks, number_of_samples * sizeof(double));
+  } else if constexpr (Codec == SampleCodec::kAlaw) {
+    kernels.convert_alaw(blocks, (int16_t*)out, number_of_samples);
+  } else {
+    kernels.convert_mulaw(blocks, (int16_t*)out, number_of_samples);
+  }
+}
+
+// converters of one integer codec and channel count, indexed by
+// [valid bits].
+template <SampleCodec Codec, unsigned int Channels, size_t... ValidBits>
+constexpr std::array<BlockConverter, sizeof...(ValidBits)> MakeMaskedRow(
+    std::index_sequence<ValidBits...>) {
+  return {{ConvertBlocks<Codec, Channels, ValidBits>...}};
+}
+
+// converters of one integer codec with ContainerBits wide samples, indexed
+// by [channels - 1][valid bits].
+template <SampleCodec Codec, unsigned int ContainerBits>
+constexpr std::array<std::array<BlockConverter, ContainerBits + 1>,
+                     kMaxChannels> kMaskedConverters = {{
+  MakeMaskedRow<Codec, 1>(std::make_index_sequence<ContainerBits + 1>()),
+  MakeMaskedRow<Codec, 2>(std::make_index_sequence<ContainerBits + 1>()),
+}};
+
+// converters of a codec without valid bits, indexed by [channels - 1].
+template <SampleCodec Codec>
+constexpr std::array<BlockConverter, kMaxChannels> kConverters = {{
+  ConvertBlocks<Codec, 1, 0>,
+  ConvertBlocks<Codec, 2, 0>,
+}};
+
+PCMKernel ResolvePCMKernel(uint16_t audio_format, unsigned int bits_per_sample,
+                           unsigned int valid_bits,
+                           unsigned int number_of_channels) {
+  PCMKernel kernel;
+  if (number_of_channels == 0 || number_of_channels > kMaxChannels) {
+    return kernel;
+  }
+  unsigned int channel = number_of_channels - 1;
+
+  if (audio_format == WAVE_FORMAT_IEEE_FLOAT) {
+    if (bits_per_sample == 32) {
+      kernel.convert = kConverters<SampleCodec::kF32>[channel];
+      kernel.sample_type = SampleType::kFloat;
+    } else if (bits_per_sample == 64) {
+      kernel.convert = kConverters<SampleCodec::kF64>[channel];
+      kernel.sample_type = SampleType::kDouble;
+    } else {
+      return kernel;
+    }
+    kernel.native = true;
+  } else if (audio_format == WAVE_FORMAT_ALAW ||
+             audio_format == WAVE_FORMAT_MULAW) {
+    // G.711 samples are 8-bits codes of 14 or 13-bits samples.
+    if (bits_per_sample != 8) {
+      return kernel;
+    }
+    kernel.convert = audio_format == WAVE_FORMAT_ALAW ?
+        kConverters<SampleCodec::kAlaw>[channel] :
+        kConverters<SampleCodec::kMulaw>[channel];
+  } else if (audio_format == WAVE_FORMAT_PCM && bits_per_sample != 0 &&
+             bits_per_sample <= kMaxBits) {
+    // samples which are not 8 bits divided are stored in the next 8 bits
+    // divided container, a 12-bits sample in 16-bits for example.
+    unsigned int container_bytes = (bits_per_sample + 7) / 8;
+    if (valid_bits == 0 || valid_bits > bits_per_sample) {
+      valid_bits = bits_per_sample;
+    }
+    switch (container_bytes) {
+      case 1:
+        kernel.convert = kConverters<SampleCodec::kU8>[channel];
+        break;
+      case 2:
+        kernel.convert = kMaskedConverters<SampleCodec::kS16, 16>[channel]
+                                                                  [valid_bits];
+        break;
+      case 3:
+        kernel.convert = kMaskedConverters<SampleCodec::kS24, 24>[channel]
+                                                                  [valid_bits];
+        break;
+      default:
+        kernel.convert = kMaskedConverters<SampleCodec::kS32, 32>[channel]
+                                                                  [valid_bits];
+        break;
+    }
+    kernel.sample_type = container_bytes <= 2 ? SampleType::kInt16 :
+                                                SampleType::kInt32;
+    // full 16-bits samples are exactly what lame takes as int16.
+    kernel.native = container_bytes == 2 && valid_bits == 16;
+  } else {
+    return kernel;
+  }
+
+  kernel.channels = number_of_channels;
+  // the instruction set is picked once, on the first call.
+  kernel.kernels = &GetSampleKernels();
+  return kernel;
+}
+
+size_t GetSampleSize(SampleType sample_type) {
+  switch (sample_type) {
+    case SampleType::kInt16:
+      return sizeof(int16_t);
+    case SampleType::kInt32:
+      return sizeof(int32_t);
+    case SampleType::kFloat:
+      return sizeof(float);
+    case SampleType::kDouble:
+      return sizeof(double);
+  }
+  return 0;
+}
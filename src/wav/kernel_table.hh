@@ -0,0 +1,78 @@
+#ifndef WASHMYWAVES_WAV_KERNEL_TABLE_H__
+#define WASHMYWAVES_WAV_KERNEL_TABLE_H__
+#include <cstddef>
+#include <cstdint>
+
+// SampleType is the type of samples that a PCMKernel produces.
+enum class SampleType {
+  kInt16,
+  kInt32,
+  kFloat,
+  kDouble,
+};
+
+struct SampleKernels;
+
+// BlockConverter converts blocks of data chunk of one format. there is an
+// instance for every (format, container width, valid bits, channels)
+// combination, which has all of them as template arguments.
+// @param kernels - instruction set the samples are converted with.
+// @param blocks - raw blocks of data chunk.
+// @param number_of_blocks - number of blocks to convert.
+// @param out - output buffer of number_of_blocks * channels samples.
+typedef void (*BlockConverter)(const SampleKernels& kernels,
+                               const uint8_t* blocks, size_t number_of_blocks,
+                               void* out);
+
+// PCMKernel converts whole blocks of data chunk of one specific format into
+// interleaved samples for lame. its block converter is chosen once per file,
+// so converting a span of blocks is a single call of a vector kernel over
+// all of its samples, with no choice left to make.
+struct PCMKernel {
+  // nullptr if the format has no kernel.
+  BlockConverter convert = nullptr;
+  SampleType sample_type = SampleType::kInt16;
+  // true if blocks are already interleaved samples of sample_type, so they
+  // can be handed to lame without converting them.
+  bool native = false;
+  // number of samples in each block.
+  unsigned int channels = 0;
+  // instruction set the samples are converted with.
+  const SampleKernels* kernels = nullptr;
+
+  // @desc - checks if the format has a kernel.
+  // @return bool
+  bool IsSupported() const {
+    return convert != nullptr;
+  }
+
+  // @desc - converts blocks of data chunk.
+  // @param blocks - raw blocks of data chunk.
+  // @param number_of_blocks - number of blocks to convert.
+  // @param out - output buffer of number_of_blocks * channels samples.
+  void Convert(const uint8_t* blocks, size_t number_of_blocks,
+               void* out) const {
+    convert(*kernels, blocks, number_of_blocks, out);
+  }
+};
+
+// @desc - looks up the kernel of a format. it is meant to be called once per
+//         file, the kernel is then called for every span of data chunk. the
+//         sample kernels are those of GetSampleKernels().
+// @param audio_format - WAVE_FORMAT_PCM, WAVE_FORMAT_IEEE_FLOAT,
+//        WAVE_FORMAT_ALAW or WAVE_FORMAT_MULAW.
+// @param bits_per_sample - width of the container of each sample, 32 or 64
+//        for float samples.
+// @param valid_bits - number of used bits in each container.
+// @param number_of_channels - number of samples in each block.
+// @return PCMKernel - unsupported if the format has no kernel.
+PCMKernel ResolvePCMKernel(uint16_t audio_format, unsigned int bits_per_sample,
+                           unsigned int valid_bits,
+                           unsigned int number_of_channels);
+
+// @desc - returns size of each sample of a type in bytes.
+// @param sample_type - the type.
+// @return size_t
+size_t GetSampleSize(SampleType sample_type);
+
+#endif // WASHMYWAVES_WAV_KERNEL_TABLE_H__
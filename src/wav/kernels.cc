@@ -0,0 +1,666 @@
+#include <array>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WASHMYWAVES_X86_KERNELS
+#endif
+
+#include "wav/kernels.hh"
+#include "utils/global.hh"
+
+// all kernels assume a little-endian host, like the wave format itself.
+
+// @desc - returns the mask that clears the unused low bits of a sample.
+// @param valid_bits - number of used bits, 0 means all of them.
+static constexpr uint16_t Mask16(unsigned int valid_bits) {
+  if (valid_bits == 0 || valid_bits >= 16) {
+    return 0xffff;
+  }
+  return (uint16_t)(0xffff << (16 - valid_bits));
+}
+
+static constexpr uint32_t Mask32(unsigned int valid_bits) {
+  if (valid_bits == 0 || valid_bits >= 32) {
+    return 0xffffffff;
+  }
+  return 0xffffffffu << (32 - valid_bits);
+}
+
+// @desc - builds the table of a kernel template, with one instance for each
+//         number of valid bits, at compile time.
+// @param make - returns the instance of a std::integral_constant of valid
+//        bits.
+template <typename Function, typename Make, size_t... ValidBits>
+static constexpr std::array<Function, sizeof...(ValidBits)> MakeMaskedKernels(
+    Make make, std::index_sequence<ValidBits...>) {
+  return {{make(std::integral_constant<unsigned int, ValidBits>())...}};
+}
+
+// the instances of a kernel template for 0 to Bits valid bits.
+#define MASKED_KERNELS(Kernel, Function, Bits)                              \
+  MakeMaskedKernels<Function>(                                              \
+      [](auto valid_bits) -> Function {                                     \
+        return Kernel<decltype(valid_bits)::value>;                         \
+      }, std::make_index_sequence<(Bits) + 1>())
+
+// @desc - builds the table of 8-bits samples, at compile time.
+static constexpr std::array<int16_t, 256> MakeU8Table() {
+  std::array<int16_t, 256> table = {};
+  for (unsigned int i = 0; i < 256; i++) {
+    // 8-bits PCM is unsigned with the center point of 128. flipping the top
+    // bit makes it signed.
+    table[i] = (int16_t)((i ^ 0x80) << 8);
+  }
+  return table;
+}
+
+static constexpr std::array<int16_t, 256> kU8Table = MakeU8Table();
+
+static void ConvertU8Scalar(const uint8_t* in, int16_t* out, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = kU8Table[in[i]];
+  }
+}
+
+// @desc - decodes a G.711 a-law sample to 16-bits, like the reference
+//         decoder of ITU-T G.191 does. the bits of a-law samples are
+//         inverted every other bit, then they are a sign, a 3-bits segment
+//         and a 4-bits step within the segment.
+static constexpr int32_t DecodeAlaw(uint8_t value) {
+  value ^= 0x55;
+  int32_t segment = (value & 0x70) >> 4;
+  int32_t sample = (value & 0x0f) << 4;
+  if (segment == 0) {
+    sample += 8;
+  } else {
+    sample = (sample + 0x108) << (segment - 1);
+  }
+  return (value & 0x80) ? sample : -sample;
+}
+
+// @desc - decodes a G.711 mu-law sample to 16-bits. mu-law samples are
+//         stored inverted, and are biased by 0x84 before they are shifted
+//         by their segment.
+static constexpr int32_t DecodeMulaw(uint8_t value) {
+  value = ~value;
+  int32_t sample = (((value & 0x0f) << 3) + 0x84) << ((value & 0x70) >> 4);
+  return (value & 0x80) ? 0x84 - sample : sample - 0x84;
+}
+
+// @desc - builds the table of a G.711 law, at compile time. the entries are
+//         32-bits wide, so vector kernels can gather them.
+static constexpr std::array<int32_t, 256> MakeG711Table(bool mu_law) {
+  std::array<int32_t, 256> table = {};
+  for (unsigned int i = 0; i < 256; i++) {
+    table[i] = mu_law ? DecodeMulaw(i) : DecodeAlaw(i);
+  }
+  return table;
+}
+
+static constexpr std::array<int32_t, 256> kAlawTable = MakeG711Table(false);
+static constexpr std::array<int32_t, 256> kMulawTable = MakeG711Table(true);
+
+template <const std::array<int32_t, 256>& Table>
+static void ConvertG711Scalar(const uint8_t* in, int16_t* out, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = Table[in[i]];
+  }
+}
+
+template <unsigned int ValidBits>
+static void ConvertS16Scalar(const uint8_t* in, int16_t* out, size_t n) {
+  constexpr auto mask = Mask16(ValidBits);
+  for (size_t i = 0; i < n; i++) {
+    uint16_t value;
+    std::memcpy(&value, in + i * 2, 2);
+    out[i] = (int16_t)(value & mask);
+  }
+}
+
+template <unsigned int ValidBits>
+static void ConvertS24Scalar(const uint8_t* in, int32_t* out, size_t n) {
+  constexpr auto mask = Mask32(ValidBits);
+  for (size_t i = 0; i < n; i++) {
+    auto sample = in + i * 3;
+    uint32_t value = (uint32_t)sample[0] << 8 | (uint32_t)sample[1] << 16 |
+                     (uint32_t)sample[2] << 24;
+    out[i] = (int32_t)(value & mask);
+  }
+}
+
+template <unsigned int ValidBits>
+static void ConvertS32Scalar(const uint8_t* in, int32_t* out, size_t n) {
+  constexpr auto mask = Mask32(ValidBits);
+  for (size_t i = 0; i < n; i++) {
+    uint32_t value;
+    std::memcpy(&value, in + i * 4, 4);
+    out[i] = (int32_t)(value & mask);
+  }
+}
+
+static void ConvertF32Scalar(const uint8_t* in, float* out, size_t n) {
+  std::memcpy(out, in, n * sizeof(float));
+}
+
+// samples are converted to float before they are multiplied, and the
+// products are added in channel order. vector kernels keep both, so they
+// round the same way.
+template <typename T>
+static void DownmixScalar(const T* in, float* out, size_t n,
+                          const DownmixMatrix& matrix) {
+  const auto channels = matrix.input_channels;
+  for (size_t f = 0; f < n; f++) {
+    auto frame = in + f * channels;
+    float left = 0;
+    float right = 0;
+    for (unsigned int c = 0; c < channels; c++) {
+      left += (float)frame[c] * matrix.gains[0][c];
+      right += (float)frame[c] * matrix.gains[1][c];
+    }
+    if (matrix.output_channels == 1) {
+      out[f] = left;
+    } else {
+      out[f * 2] = left;
+      out[f * 2 + 1] = right;
+    }
+  }
+}
+
+static const SampleKernels kScalarKernels = {
+  "scalar",
+  ConvertU8Scalar,
+  MASKED_KERNELS(ConvertS16Scalar, ConvertS16Function, 16),
+  MASKED_KERNELS(ConvertS24Scalar, ConvertS32Function, 24),
+  MASKED_KERNELS(ConvertS32Scalar, ConvertS32Function, 32),
+  ConvertF32Scalar,
+  ConvertG711Scalar<kAlawTable>,
+  ConvertG711Scalar<kMulawTable>,
+  DownmixScalar<int16_t>,
+  DownmixScalar<int32_t>,
+  DownmixScalar<float>,
+  DownmixScalar<double>,
+};
+
+#ifdef WASHMYWAVES_X86_KERNELS
+// each vector kernel converts as many samples as fit in whole registers and
+// leaves the tail to the scalar kernel.
+
+__attribute__((target("sse2")))
+static void ConvertU8SSE2(const uint8_t* in, int16_t* out, size_t n) {
+  const __m128i sign = _mm_set1_epi8((char)0x80);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto value = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + i)),
+                               sign);
+    // interleaving with zeroes puts each byte in the high half of a word.
+    _mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi8(zero, value));
+    _mm_storeu_si128((__m128i*)(out + i + 8), _mm_unpackhi_epi8(zero, value));
+  }
+  ConvertU8Scalar(in + i, out + i, n - i);
+}
+
+template <unsigned int ValidBits>
+__attribute__((target("sse2")))
+static void ConvertS16SSE2(const uint8_t* in, int16_t* out, size_t n) {
+  const __m128i mask = _mm_set1_epi16((short)Mask16(ValidBits));
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    auto value = _mm_loadu_si128((const __m128i*)(in + i * 2));
+    _mm_storeu_si128((__m128i*)(out + i), _mm_and_si128(value, mask));
+  }
+  ConvertS16Scalar<ValidBits>(in + i * 2, out + i, n - i);
+}
+
+template <unsigned int ValidBits>
+__attribute__((target("ssse3")))
+static void ConvertS24SSSE3(const uint8_t* in, int32_t* out, size_t n) {
+  const __m128i mask = _mm_set1_epi32((int)Mask32(ValidBits));
+  // moves the 3 bytes of each sample to the top of a dword, -1 clears a byte.
+  const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+                                        -1, 6, 7, 8, -1, 9, 10, 11);
+  size_t i = 0;
+  // 4 samples take 12 bytes, but 16 bytes are loaded.
+  for (; (n - i) * 3 >= 16; i += 4) {
+    auto value = _mm_loadu_si128((const __m128i*)(in + i * 3));
+    value = _mm_shuffle_epi8(value, shuffle);
+    _mm_storeu_si128((__m128i*)(out + i), _mm_and_si128(value, mask));
+  }
+  ConvertS24Scalar<ValidBits>(in + i * 3, out + i, n - i);
+}
+
+template <unsigned int ValidBits>
+__attribute__((target("sse2")))
+static void ConvertS32SSE2(const uint8_t* in, int32_t* out, size_t n) {
+  const __m128i mask = _mm_set1_epi32((int)Mask32(ValidBits));
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    auto value = _mm_loadu_si128((const __m128i*)(in + i * 4));
+    _mm_storeu_si128((__m128i*)(out + i), _mm_and_si128(value, mask));
+  }
+  ConvertS32Scalar<ValidBits>(in + i * 4, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void ConvertU8AVX2(const uint8_t* in, int16_t* out, size_t n) {
+  const __m256i sign = _mm256_set1_epi16(0x80);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto value = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128((const __m128i*)(in + i)));
+    value = _mm256_slli_epi16(_mm256_xor_si256(value, sign), 8);
+    _mm256_storeu_si256((__m256i*)(out + i), value);
+  }
+  ConvertU8Scalar(in + i, out + i, n - i);
+}
+
+// the table is gathered 8 entries at a time, the bytes are widened to 32-bits
+// indexes for it.
+template <const std::array<int32_t, 256>& Table>
+__attribute__((target("avx2")))
+static void ConvertG711AVX2(const uint8_t* in, int16_t* out, size_t n) {
+  auto table = (const int*)Table.data();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto bytes = _mm_loadu_si128((const __m128i*)(in + i));
+    auto low = _mm256_i32gather_epi32(table, _mm256_cvtepu8_epi32(bytes), 4);
+    auto high = _mm256_i32gather_epi32(
+        table, _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)), 4);
+    // packing works within 128-bits lanes, the permute puts the samples back
+    // in order.
+    auto value = _mm256_permute4x64_epi64(_mm256_packs_epi32(low, high),
+                                          0xd8);
+    _mm256_storeu_si256((__m256i*)(out + i), value);
+  }
+  ConvertG711Scalar<Table>(in + i, out + i, n - i);
+}
+
+template <unsigned int ValidBits>
+__attribute__((target("avx2")))
+static void ConvertS16AVX2(const uint8_t* in, int16_t* out, size_t n) {
+  const __m256i mask = _mm256_set1_epi16((short)Mask16(ValidBits));
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto value = _mm256_loadu_si256((const __m256i*)(in + i * 2));
+    _mm256_storeu_si256((__m256i*)(out + i), _mm256_and_si256(value, mask));
+  }
+  ConvertS16Scalar<ValidBits>(in + i * 2, out + i, n - i);
+}
+
+template <unsigned int ValidBits>
+__attribute__((target("avx2")))
+static void ConvertS24AVX2(const uint8_t* in, int32_t* out, size_t n) {
+  const __m256i mask = _mm256_set1_epi32((int)Mask32(ValidBits));
+  // byte shuffles cannot cross 128-bit lanes, so the 12 bytes of the upper 4
+  // samples are first moved to the upper lane.
+  const __m256i spread = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+  const __m256i shuffle = _mm256_setr_epi8(
+      -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+      -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+  size_t i = 0;
+  // 8 samples take 24 bytes, but 32 bytes are loaded.
+  for (; (n - i) * 3 >= 32; i += 8) {
+    auto value = _mm256_loadu_si256((const __m256i*)(in + i * 3));
+    value = _mm256_permutevar8x32_epi32(value, spread);
+    value = _mm256_shuffle_epi8(value, shuffle);
+    _mm256_storeu_si256((__m256i*)(out + i), _mm256_and_si256(value, mask));
+  }
+  ConvertS24Scalar<ValidBits>(in + i * 3, out + i, n - i);
+}
+
+template <unsigned int ValidBits>
+__attribute__((target("avx2")))
+static void ConvertS32AVX2(const uint8_t* in, int32_t* out, size_t n) {
+  const __m256i mask = _mm256_set1_epi32((int)Mask32(ValidBits));
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    auto value = _mm256_loadu_si256((const __m256i*)(in + i * 4));
+    _mm256_storeu_si256((__m256i*)(out + i), _mm256_and_si256(value, mask));
+  }
+  ConvertS32Scalar<ValidBits>(in + i * 4, out + i, n - i);
+}
+
+// 8 frames are mixed at a time. each channel of them is gathered into a
+// register, strided by the number of channels. 16-bits samples are gathered
+// as 32-bits words and sign-extended, so the word of the last sample of a
+// frame runs into the next frame, which must be there.
+template <typename T>
+__attribute__((target("avx2")))
+static void DownmixAVX2(const T* in, float* out, size_t n,
+                        const DownmixMatrix& matrix) {
+  const auto channels = matrix.input_channels;
+  const auto index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5,
+                                                          6, 7),
+                                        _mm256_set1_epi32(channels));
+  const size_t overrun = sizeof(T) == 2 ? 1 : 0;
+  size_t f = 0;
+  for (; f + 8 + overrun <= n; f += 8) {
+    auto frames = in + f * channels;
+    auto left = _mm256_setzero_ps();
+    auto right = _mm256_setzero_ps();
+    for (unsigned int c = 0; c < channels; c++) {
+      __m256 value;
+      if constexpr (sizeof(T) == 2) {
+        auto words = _mm256_i32gather_epi32((const int*)(frames + c), index,
+                                            2);
+        value = _mm256_cvtepi32_ps(
+            _mm256_srai_epi32(_mm256_slli_epi32(words, 16), 16));
+      } else if constexpr (std::is_integral_v<T>) {
+        value = _mm256_cvtepi32_ps(
+            _mm256_i32gather_epi32((const int*)(frames + c), index, 4));
+      } else {
+        value = _mm256_i32gather_ps(frames + c, index, 4);
+      }
+      // no fused multiply-add, it would round differently from the scalar
+      // kernel.
+      left = _mm256_add_ps(left, _mm256_mul_ps(
+          value, _mm256_set1_ps(matrix.gains[0][c])));
+      right = _mm256_add_ps(right, _mm256_mul_ps(
+          value, _mm256_set1_ps(matrix.gains[1][c])));
+    }
+    if (matrix.output_channels == 1) {
+      _mm256_storeu_ps(out + f, left);
+    } else {
+      // unpacking works within 128-bits lanes, the permutes put the frames
+      // back in order.
+      auto low = _mm256_unpacklo_ps(left, right);
+      auto high = _mm256_unpackhi_ps(left, right);
+      _mm256_storeu_ps(out + f * 2, _mm256_permute2f128_ps(low, high, 0x20));
+      _mm256_storeu_ps(out + f * 2 + 8,
+                       _mm256_permute2f128_ps(low, high, 0x31));
+    }
+  }
+  DownmixScalar<T>(in + f * channels, out + f * matrix.output_channels,
+                   n - f, matrix);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void ConvertU8AVX512(const uint8_t* in, int16_t* out, size_t n) {
+  const __m512i sign = _mm512_set1_epi16(0x80);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    auto value = _mm512_cvtepu8_epi16(
+        _mm256_loadu_si256((const __m256i*)(in + i)));
+    value = _mm512_slli_epi16(_mm512_xor_si512(value, sign), 8);
+    _mm512_storeu_si512((void*)(out + i), value);
+  }
+  ConvertU8Scalar(in + i, out + i, n - i);
+}
+
+// the masked forms of the intrinsics are used with every lane enabled, gcc
+// warns about the undefined source of the plain ones.
+template <const std::array<int32_t, 256>& Table>
+__attribute__((target("avx512f")))
+static void ConvertG711AVX512(const uint8_t* in, int16_t* out, size_t n) {
+  auto table = (const int*)Table.data();
+  const __m512i zero = _mm512_setzero_si512();
+  const __mmask16 all = 0xffff;
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto index = _mm512_maskz_cvtepu8_epi32(
+        all, _mm_loadu_si128((const __m128i*)(in + i)));
+    auto value = _mm512_mask_i32gather_epi32(zero, all, index, table, 4);
+    _mm512_mask_cvtepi32_storeu_epi16(out + i, all, value);
+  }
+  ConvertG711Scalar<Table>(in + i, out + i, n - i);
+}
+
+template <unsigned int ValidBits>
+__attribute__((target("avx512f,avx512bw")))
+static void ConvertS16AVX512(const uint8_t* in, int16_t* out, size_t n) {
+  const __m512i mask = _mm512_set1_epi16((short)Mask16(ValidBits));
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    auto value = _mm512_loadu_si512((const void*)(in + i * 2));
+    _mm512_storeu_si512((void*)(out + i), _mm512_and_si512(value, mask));
+  }
+  ConvertS16Scalar<ValidBits>(in + i * 2, out + i, n - i);
+}
+
+template <unsigned int ValidBits>
+__attribute__((target("avx512f,avx512bw")))
+static void ConvertS24AVX512(const uint8_t* in, int32_t* out, size_t n) {
+  const __m512i mask = _mm512_set1_epi32((int)Mask32(ValidBits));
+  // the 12 bytes of each group of 4 samples are moved to their own 128-bit
+  // lane before shuffling bytes inside the lanes.
+  const __m512i spread = _mm512_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0,
+                                           6, 7, 8, 0, 9, 10, 11, 0);
+  // the same byte shuffle as the other sets, written as dwords: -1, 0, 1, 2,
+  // -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11 in each lane.
+  const __m512i shuffle = _mm512_set4_epi32(0x0b0a09ff, 0x080706ff,
+                                            0x050403ff, 0x020100ff);
+  // 16 samples take 48 bytes, the masked load does not touch the rest.
+  const __mmask64 load_mask = 0xffffffffffffULL;
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto value = _mm512_maskz_loadu_epi8(load_mask, in + i * 3);
+    value = _mm512_maskz_permutexvar_epi32(0xffff, spread, value);
+    value = _mm512_shuffle_epi8(value, shuffle);
+    _mm512_storeu_si512((void*)(out + i), _mm512_and_si512(value, mask));
+  }
+  ConvertS24Scalar<ValidBits>(in + i * 3, out + i, n - i);
+}
+
+template <unsigned int ValidBits>
+__attribute__((target("avx512f")))
+static void ConvertS32AVX512(const uint8_t* in, int32_t* out, size_t n) {
+  const __m512i mask = _mm512_set1_epi32((int)Mask32(ValidBits));
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto value = _mm512_loadu_si512((const void*)(in + i * 4));
+    _mm512_storeu_si512((void*)(out + i), _mm512_and_si512(value, mask));
+  }
+  ConvertS32Scalar<ValidBits>(in + i * 4, out + i, n - i);
+}
+
+// the 128-bit set needs ssse3 for the byte shuffle of 24-bits samples, every
+// x86-64 cpu made since 2006 has it.
+static const SampleKernels kSSSE3Kernels = {
+  "ssse3",
+  ConvertU8SSE2,
+  MASKED_KERNELS(ConvertS16SSE2, ConvertS16Function, 16),
+  MASKED_KERNELS(ConvertS24SSSE3, ConvertS32Function, 24),
+  MASKED_KERNELS(ConvertS32SSE2, ConvertS32Function, 32),
+  ConvertF32Scalar,
+  // there is no gather before avx2.
+  ConvertG711Scalar<kAlawTable>,
+  ConvertG711Scalar<kMulawTable>,
+  DownmixScalar<int16_t>,
+  DownmixScalar<int32_t>,
+  DownmixScalar<float>,
+  DownmixScalar<double>,
+};
+
+static const SampleKernels kAVX2Kernels = {
+  "avx2",
+  ConvertU8AVX2,
+  MASKED_KERNELS(ConvertS16AVX2, ConvertS16Function, 16),
+  MASKED_KERNELS(ConvertS24AVX2, ConvertS32Function, 24),
+  MASKED_KERNELS(ConvertS32AVX2, ConvertS32Function, 32),
+  ConvertF32Scalar,
+  ConvertG711AVX2<kAlawTable>,
+  ConvertG711AVX2<kMulawTable>,
+  DownmixAVX2<int16_t>,
+  DownmixAVX2<int32_t>,
+  DownmixAVX2<float>,
+  // doubles are rare enough to be mixed by the scalar kernel.
+  DownmixScalar<double>,
+};
+
+static const SampleKernels kAVX512Kernels = {
+  "avx512",
+  ConvertU8AVX512,
+  MASKED_KERNELS(ConvertS16AVX512, ConvertS16Function, 16),
+  MASKED_KERNELS(ConvertS24AVX512, ConvertS32Function, 24),
+  MASKED_KERNELS(ConvertS32AVX512, ConvertS32Function, 32),
+  ConvertF32Scalar,
+  ConvertG711AVX512<kAlawTable>,
+  ConvertG711AVX512<kMulawTable>,
+  // mixing is bound by the gathers, wider ones do not make it faster.
+  DownmixAVX2<int16_t>,
+  DownmixAVX2<int32_t>,
+  DownmixAVX2<float>,
+  DownmixScalar<double>,
+};
+#endif // WASHMYWAVES_X86_KERNELS
+
+const SampleKernels* FindSampleKernels(const char* name) {
+  if (std::strcmp(name, kScalarKernels.name) == 0) {
+    return &kScalarKernels;
+  }
+#ifdef WASHMYWAVES_X86_KERNELS
+  __builtin_cpu_init();
+  if (std::strcmp(name, kSSSE3Kernels.name) == 0 &&
+      __builtin_cpu_supports("ssse3")) {
+    return &kSSSE3Kernels;
+  }
+  if (std::strcmp(name, kAVX2Kernels.name) == 0 &&
+      __builtin_cpu_supports("avx2")) {
+    return &kAVX2Kernels;
+  }
+  if (std::strcmp(name, kAVX512Kernels.name) == 0 &&
+      __builtin_cpu_supports("avx512f") &&
+      __builtin_cpu_supports("avx512bw")) {
+    return &kAVX512Kernels;
+  }
+#endif
+  return nullptr;
+}
+
+const SampleKernels& GetSampleKernels() {
+  static const SampleKernels* kernels = [] {
+    for (auto name : {"avx512", "avx2", "ssse3"}) {
+      auto found = FindSampleKernels(name);
+      if (found) {
+#ifdef DEBUG
+        // debug builds check the vector kernels against the scalar ones.
+        if (!ValidateSampleKernels(*found)) {
+          PRINTF("%s kernels do not match the scalar kernels.\n", name);
+          continue;
+        }
+#endif
+        return found;
+      }
+    }
+    return &kScalarKernels;
+  }();
+  return *kernels;
+}
+
+const SampleKernels& GetScalarSampleKernels() {
+  return kScalarKernels;
+}
+
+// @desc - mixes pseudo-random frames of every sample type down with the
+//         given kernels and compares the results with the scalar kernels.
+// @return bool - true if all results match.
+static bool ValidateDownmixKernels(const SampleKernels& kernels) {
+  const size_t kMaxFrames = 301;
+  const size_t kMaxSamples = kMaxFrames * kMaxDownmixChannels;
+  std::vector<int16_t> input_s16(kMaxSamples);
+  std::vector<int32_t> input_s32(kMaxSamples);
+  std::vector<float> input_f32(kMaxSamples);
+  std::vector<double> input_f64(kMaxSamples);
+  uint32_t seed = 0x9e3779b9;
+  for (size_t i = 0; i < kMaxSamples; i++) {
+    seed = seed * 1664525 + 1013904223;
+    input_s16[i] = seed >> 16;
+    input_s32[i] = seed;
+    // float samples stay in range, like real ones.
+    input_f32[i] = input_s16[i] / 32768.0f;
+    input_f64[i] = input_s32[i] / 2147483648.0;
+  }
+
+  std::vector<float> expected(kMaxFrames * 2), actual(kMaxFrames * 2);
+  auto check = [&](size_t size) {
+    return std::memcmp(expected.data(), actual.data(),
+                       size * sizeof(float)) == 0;
+  };
+  for (unsigned int channels : {1, 3, 6, 8, 13}) {
+    for (unsigned int output_channels : {1, 2}) {
+      auto matrix = MakeDownmixMatrix(0, channels, output_channels);
+      for (size_t n = 0; n <= kMaxFrames; n += (n < 20 ? 1 : 70)) {
+        auto size = n * output_channels;
+        kScalarKernels.downmix_s16(input_s16.data(), expected.data(), n,
+                                   matrix);
+        kernels.downmix_s16(input_s16.data(), actual.data(), n, matrix);
+        if (!check(size)) return false;
+        kScalarKernels.downmix_s32(input_s32.data(), expected.data(), n,
+                                   matrix);
+        kernels.downmix_s32(input_s32.data(), actual.data(), n, matrix);
+        if (!check(size)) return false;
+        kScalarKernels.downmix_f32(input_f32.data(), expected.data(), n,
+                                   matrix);
+        kernels.downmix_f32(input_f32.data(), actual.data(), n, matrix);
+        if (!check(size)) return false;
+        kScalarKernels.downmix_f64(input_f64.data(), expected.data(), n,
+                                   matrix);
+        kernels.downmix_f64(input_f64.data(), actual.data(), n, matrix);
+        if (!check(size)) return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool ValidateSampleKernels(const SampleKernels& kernels) {
+  // sizes around the register widths exercise both the vector loops and the
+  // scalar tails.
+  const size_t kMaxSamples = 1027;
+  std::vector<uint8_t> input(kMaxSamples * 4);
+  uint32_t seed = 0x2545f491;
+  for (auto& byte : input) {
+    seed = seed * 1664525 + 1013904223;
+    byte = seed >> 24;
+  }
+
+  std::vector<uint8_t> expected(kMaxSamples * 4), actual(kMaxSamples * 4);
+  auto check = [&](size_t size) {
+    return std::memcmp(expected.data(), actual.data(), size) == 0;
+  };
+  for (size_t n = 0; n <= kMaxSamples; n += (n < 70 ? 1 : 239)) {
+    kScalarKernels.convert_u8(input.data(), (int16_t*)expected.data(), n);
+    kernels.convert_u8(input.data(), (int16_t*)actual.data(), n);
+    if (!check(n * 2)) return false;
+
+    // every instance of the integer kernels, as every one is compiled on
+    // its own.
+    for (unsigned int valid_bits = 0; valid_bits <= 16; valid_bits++) {
+      kScalarKernels.convert_s16[valid_bits](input.data(),
+                                             (int16_t*)expected.data(), n);
+      kernels.convert_s16[valid_bits](input.data(), (int16_t*)actual.data(),
+                                      n);
+      if (!check(n * 2)) return false;
+    }
+    for (unsigned int valid_bits = 0; valid_bits <= 24; valid_bits++) {
+      kScalarKernels.convert_s24[valid_bits](input.data(),
+                                             (int32_t*)expected.data(), n);
+      kernels.convert_s24[valid_bits](input.data(), (int32_t*)actual.data(),
+                                      n);
+      if (!check(n * 4)) return false;
+    }
+    for (unsigned int valid_bits = 0; valid_bits <= 32; valid_bits++) {
+      kScalarKernels.convert_s32[valid_bits](input.data(),
+                                             (int32_t*)expected.data(), n);
+      kernels.convert_s32[valid_bits](input.data(), (int32_t*)actual.data(),
+                                      n);
+      if (!check(n * 4)) return false;
+    }
+    kScalarKernels.convert_f32(input.data(), (float*)expected.data(), n);
+    kernels.convert_f32(input.data(), (float*)actual.data(), n);
+    if (!check(n * 4)) return false;
+
+    kScalarKernels.convert_alaw(input.data(), (int16_t*)expected.data(), n);
+    kernels.convert_alaw(input.data(), (int16_t*)actual.data(), n);
+    if (!check(n * 2)) return false;
+    kScalarKernels.convert_mulaw(input.data(), (int16_t*)expected.data(), n);
+    kernels.convert_mulaw(input.data(), (int16_t*)actual.data(), n);
+    if (!check(n * 2)) return false;
+  }
+  return ValidateDownmixKernels(kernels);
+}
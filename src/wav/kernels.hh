@@ -0,0 +1,76 @@
+#ifndef WASHMYWAVES_WAV_KERNELS_H__
+#define WASHMYWAVES_WAV_KERNELS_H__
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "wav/downmix.hh"
+
+// kernels of integer samples which keep a fixed number of valid bits. the
+// number is a template argument of each kernel, so the mask that clears the
+// unused bits is a constant of its loop.
+typedef void (*ConvertS16Function)(const uint8_t* in, int16_t* out,
+                                   size_t n);
+typedef void (*ConvertS32Function)(const uint8_t* in, int32_t* out,
+                                   size_t n);
+
+// SampleKernels is a set of functions which convert raw little-endian
+// samples of data chunk into the form lame accepts. integer samples are
+// stored left-justified in their container, as the wave format specifies, so
+// converting them is sign-extending to 16 or 32-bits and clearing the unused
+// low bits. every function converts n interleaved samples, the input does
+// not have to be aligned. kernels of integer samples are indexed by the
+// number of valid bits, [0] keeps all of them.
+struct SampleKernels {
+  // name of the instruction set the kernels are written for.
+  const char* name;
+  // unsigned 8-bits samples to 16-bits.
+  void (*convert_u8)(const uint8_t* in, int16_t* out, size_t n);
+  // up to 16-bits samples in a 16-bits container.
+  std::array<ConvertS16Function, 17> convert_s16;
+  // up to 24-bits samples in a 24-bits container, to 32-bits.
+  std::array<ConvertS32Function, 25> convert_s24;
+  // up to 32-bits samples in a 32-bits container.
+  std::array<ConvertS32Function, 33> convert_s32;
+  // ieee float samples, lame takes them as they are.
+  void (*convert_f32)(const uint8_t* in, float* out, size_t n);
+  // G.711 a-law and mu-law samples, decoded to 16-bits through a table.
+  void (*convert_alaw)(const uint8_t* in, int16_t* out, size_t n);
+  void (*convert_mulaw)(const uint8_t* in, int16_t* out, size_t n);
+  // mix n frames of converted samples down to matrix.output_channels float
+  // samples each. samples are multiplied by the gains as they are, so the
+  // gains of integer samples carry their scale. the kernels give the same
+  // results as the scalar ones, to the bit.
+  void (*downmix_s16)(const int16_t* in, float* out, size_t n,
+                      const DownmixMatrix& matrix);
+  void (*downmix_s32)(const int32_t* in, float* out, size_t n,
+                      const DownmixMatrix& matrix);
+  void (*downmix_f32)(const float* in, float* out, size_t n,
+                      const DownmixMatrix& matrix);
+  void (*downmix_f64)(const double* in, float* out, size_t n,
+                      const DownmixMatrix& matrix);
+};
+
+// @desc - returns the fastest kernels the cpu supports. the choice is made
+//         once, from cpuid, on the first call.
+// @return SampleKernels
+const SampleKernels& GetSampleKernels();
+
+// @desc - returns the plain c++ kernels. they are the reference the vector
+//         kernels are validated against.
+// @return SampleKernels
+const SampleKernels& GetScalarSampleKernels();
+
+// @desc - looks up kernels by name, "scalar", "ssse3", "avx2" or "avx512".
+// @param name - name of the instruction set.
+// @return const SampleKernels* - nullptr if the cpu does not support them.
+const SampleKernels* FindSampleKernels(const char* name);
+
+// @desc - converts pseudo-random samples of every width, and mixes frames
+//         of them down, with the given kernels and compares the results
+//         with the scalar kernels.
+// @param kernels - the kernels to validate.
+// @return bool - true if all results match.
+bool ValidateSampleKernels(const SampleKernels& kernels);
+
+#endif // WASHMYWAVES_WAV_KERNELS_H__
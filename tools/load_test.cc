@@ -0,0 +1,337 @@
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Metric is a measured quantity of a run.
+struct Metric {
+  const char* name;
+  // true if larger values are better.
+  bool higher_is_better;
+};
+
+static const Metric kMetrics[] = {
+  {"files_per_second", true},
+  {"mb_per_second", true},
+  {"wall_seconds", false},
+  {"cpu_seconds", false},
+  {"peak_rss_mb", false},
+};
+
+// Corpus is what the runner knows about the input of washmywaves.
+struct Corpus {
+  std::vector<std::filesystem::path> wav_files;
+  uint64_t total_size = 0;
+};
+
+// RunResult is the outcome of one run of washmywaves.
+struct RunResult {
+  bool succeeded = false;
+  // number of wav files with an mp3 file after the run.
+  size_t converted = 0;
+  std::map<std::string, double> metrics;
+};
+
+// @desc - finds the wav files of a directory tree, the same way washmywaves
+//         does.
+static Corpus ScanCorpus(const std::filesystem::path& directory) {
+  Corpus corpus;
+  std::error_code error;
+  for (auto& entry :
+       std::filesystem::recursive_directory_iterator(directory, error)) {
+    auto extension = entry.path().extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   ::tolower);
+    if (extension == ".wav" && entry.is_regular_file(error)) {
+      corpus.wav_files.push_back(entry.path());
+      corpus.total_size += entry.file_size(error);
+    }
+  }
+  return corpus;
+}
+
+// @desc - removes the mp3 files of a corpus, so every run converts all of
+//         it. only mp3 files next to a wav file of the same name are removed.
+static void RemoveOutputs(const Corpus& corpus) {
+  for (auto path : corpus.wav_files) {
+    std::error_code error;
+    std::filesystem::remove(path.replace_extension(".mp3"), error);
+  }
+}
+
+// @desc - runs washmywaves once over the corpus and measures it. its output
+//         is discarded, the time and resource usage of the process are taken
+//         from wait4().
+// @param arguments - command line, the binary first.
+// @param corpus - the corpus, its mp3 files are removed first.
+// @return RunResult
+static RunResult Run(const std::vector<std::string>& arguments,
+                     const Corpus& corpus) {
+  RunResult result;
+  RemoveOutputs(corpus);
+
+  std::vector<char*> argv;
+  for (auto& argument : arguments) {
+    argv.push_back((char*)argument.c_str());
+  }
+  argv.push_back(nullptr);
+
+  auto start = std::chrono::steady_clock::now();
+  auto pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    return result;
+  }
+  if (pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    execv(argv[0], argv.data());
+    _exit(127);
+  }
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0) {
+    perror("wait4");
+    return result;
+  }
+  auto wall = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  result.succeeded = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+  for (auto path : corpus.wav_files) {
+    std::error_code error;
+    if (std::filesystem::exists(path.replace_extension(".mp3"), error)) {
+      ++result.converted;
+    }
+  }
+
+  auto cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+             usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+  result.metrics["files_per_second"] = corpus.wav_files.size() / wall;
+  result.metrics["mb_per_second"] = corpus.total_size / 1e6 / wall;
+  result.metrics["wall_seconds"] = wall;
+  result.metrics["cpu_seconds"] = cpu;
+  // ru_maxrss is in kilobytes on linux.
+  result.metrics["peak_rss_mb"] = usage.ru_maxrss / 1024.0;
+  return result;
+}
+
+// @desc - reads a baseline written by SaveBaseline().
+// @return bool - false if the file cannot be read.
+static bool LoadBaseline(const std::filesystem::path& path,
+                         std::map<std::string, double>& baseline) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    char name[64];
+    double value;
+    if (sscanf(line.c_str(), "%63s %lf", name, &value) == 2) {
+      baseline[name] = value;
+    }
+  }
+  return true;
+}
+
+// @desc - writes the metrics of a run and the shape of the corpus, one
+//         "name value" pair per line.
+// @return bool - false if the file cannot be written.
+static bool SaveBaseline(const std::filesystem::path& path,
+                         const Corpus& corpus,
+                         const std::map<std::string, double>& metrics) {
+  std::ofstream file(path, std::ios::trunc);
+  file << "# washmywaves load test baseline\n";
+  file << "files " << corpus.wav_files.size() << "\n";
+  file << "bytes " << corpus.total_size << "\n";
+  for (auto& metric : kMetrics) {
+    file << metric.name << " " << metrics.at(metric.name) << "\n";
+  }
+  return (bool)file;
+}
+
+// @desc - compares metrics with a baseline and prints the differences.
+// @param threshold - allowed change to the worse, in percent.
+// @return bool - true if no metric regressed beyond the threshold.
+static bool CompareWithBaseline(const Corpus& corpus,
+                                const std::map<std::string, double>& metrics,
+                                const std::map<std::string, double>& baseline,
+                                double threshold) {
+  auto files = baseline.find("files");
+  auto bytes = baseline.find("bytes");
+  if (files == baseline.end() || files->second != corpus.wav_files.size() ||
+      bytes == baseline.end() || bytes->second != corpus.total_size) {
+    printf("warning: the baseline was measured on a different corpus.\n");
+  }
+
+  bool passed = true;
+  printf("%-18s %12s %12s %9s\n", "metric", "baseline", "current", "change");
+  for (auto& metric : kMetrics) {
+    auto expected = baseline.find(metric.name);
+    if (expected == baseline.end() || expected->second == 0) {
+      continue;
+    }
+    auto current = metrics.at(metric.name);
+    auto change = (current - expected->second) / expected->second * 100;
+    bool regressed = metric.higher_is_better ? change < -threshold
+                                             : change > threshold;
+    passed = passed && !regressed;
+    printf("%-18s %12.3f %12.3f %+8.1f%% %s\n", metric.name, expected->second,
+           current, change, regressed ? "REGRESSION" : "");
+  }
+  return passed;
+}
+
+void PrintUsage() {
+  printf("USAGE: washmywaves_load [options] corpus_directory "
+         "[-- washmywaves options]\n");
+  printf("  options:\n");
+  printf("    -b, --binary PATH  washmywaves binary, ./washmywaves by\n");
+  printf("                  default.\n");
+  printf("    -n, --runs N  number of runs, 3 by default. the run with the\n");
+  printf("                  median wall time is reported.\n");
+  printf("    --baseline FILE  compare with a baseline, exits with 2 if a\n");
+  printf("                  metric is worse by more than the threshold.\n");
+  printf("    --save-baseline FILE  write the results as a baseline.\n");
+  printf("    -t, --threshold PCT  allowed regression, 5%% by default.\n");
+  printf("  mp3 files of the corpus are removed before every run.\n");
+}
+
+int main(int argc, char* argv[]) {
+  std::string binary = "./washmywaves";
+  unsigned int runs = 3;
+  const char* baseline_path = nullptr;
+  const char* save_path = nullptr;
+  double threshold = 5;
+
+  const struct option long_options[] = {
+    {"binary", required_argument, nullptr, 'b'},
+    {"runs", required_argument, nullptr, 'n'},
+    {"baseline", required_argument, nullptr, 'B'},
+    {"save-baseline", required_argument, nullptr, 'S'},
+    {"threshold", required_argument, nullptr, 't'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "b:n:t:h", long_options,
+                               nullptr)) != -1) {
+    switch (option) {
+      case 'b':
+        binary = optarg;
+        break;
+      case 'n': {
+        char* end = nullptr;
+        auto value = strtol(optarg, &end, 10);
+        if (*end != '\0' || value <= 0) {
+          printf("invalid number of runs: %s\n", optarg);
+          return 1;
+        }
+        runs = value;
+        break;
+      }
+      case 'B':
+        baseline_path = optarg;
+        break;
+      case 'S':
+        save_path = optarg;
+        break;
+      case 't': {
+        char* end = nullptr;
+        threshold = strtod(optarg, &end);
+        if (*end != '\0' || threshold < 0) {
+          printf("invalid threshold: %s\n", optarg);
+          return 1;
+        }
+        break;
+      }
+      case 'h':
+        PrintUsage();
+        return 0;
+      default:
+        PrintUsage();
+        return 1;
+    }
+  }
+  if (optind >= argc) {
+    PrintUsage();
+    return 1;
+  }
+  std::filesystem::path directory = argv[optind++];
+
+  // options after the corpus, getopt stops at "--", go to washmywaves.
+  std::vector<std::string> arguments = {binary};
+  for (int i = optind; i < argc; ++i) {
+    arguments.push_back(argv[i]);
+  }
+  arguments.push_back(directory.string());
+
+  auto corpus = ScanCorpus(directory);
+  if (corpus.wav_files.empty()) {
+    printf("[ERROR] %s: no wav files found.\n", directory.c_str());
+    return 1;
+  }
+  printf("corpus: %zu files, %.1f MB\n", corpus.wav_files.size(),
+         corpus.total_size / 1e6);
+
+  std::vector<RunResult> results;
+  for (unsigned int i = 0; i < runs; ++i) {
+    auto result = Run(arguments, corpus);
+    if (!result.succeeded) {
+      printf("[ERROR] run %u: washmywaves failed.\n", i + 1);
+      return 1;
+    }
+    printf("run %u: %.2fs wall, %.2fs cpu, %.1f MB peak rss, %zu/%zu files "
+           "converted\n", i + 1, result.metrics["wall_seconds"],
+           result.metrics["cpu_seconds"], result.metrics["peak_rss_mb"],
+           result.converted, corpus.wav_files.size());
+    results.push_back(result);
+  }
+  std::sort(results.begin(), results.end(),
+            [](RunResult& a, RunResult& b) {
+              return a.metrics["wall_seconds"] < b.metrics["wall_seconds"];
+            });
+  auto& median = results[results.size() / 2];
+  printf("median: %.1f files/s, %.1f MB/s, %.2fs wall, %.2fs cpu, "
+         "%.1f MB peak rss\n", median.metrics["files_per_second"],
+         median.metrics["mb_per_second"], median.metrics["wall_seconds"],
+         median.metrics["cpu_seconds"], median.metrics["peak_rss_mb"]);
+  if (median.converted != corpus.wav_files.size()) {
+    printf("warning: %zu files were not converted.\n",
+           corpus.wav_files.size() - median.converted);
+  }
+
+  int exit_code = 0;
+  if (baseline_path) {
+    std::map<std::string, double> baseline;
+    if (!LoadBaseline(baseline_path, baseline)) {
+      printf("[ERROR] %s: cannot read baseline.\n", baseline_path);
+      return 1;
+    }
+    if (!CompareWithBaseline(corpus, median.metrics, baseline, threshold)) {
+      exit_code = 2;
+    }
+  }
+  if (save_path && !SaveBaseline(save_path, corpus, median.metrics)) {
+    printf("[ERROR] %s: cannot write baseline.\n", save_path);
+    return 1;
+  }
+  return exit_code;
+}
@@ -0,0 +1,410 @@
+#include <getopt.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "wav/downmix.hh"
+
+#include "wav_synth.hh"
+
+// number of frames generated and written in one step.
+const size_t kFramesPerWrite = 64 * 1024;
+
+// largest data chunk a file can have, riff sizes are 32-bits and the header
+// and trailer need some room.
+const uint64_t kMaxDataSize = 0xFFFFFFFFULL - 4096;
+
+// SizeDistribution draws the sizes of the sample data of files.
+struct SizeDistribution {
+  enum Kind {
+    kFixed,
+    kUniform,
+    kLogUniform,
+    kLogNormal,
+  } kind = kLogUniform;
+  // minimum and maximum, or median and sigma of the natural logarithm for
+  // kLogNormal.
+  double a = 64 * 1024;
+  double b = 16 * 1024 * 1024;
+
+  // @param random - the generator.
+  // @return uint64_t - a size in bytes.
+  uint64_t Draw(Random& random) const {
+    double size = a;
+    switch (kind) {
+      case kFixed:
+        break;
+      case kUniform:
+        size = a + (b - a) * random.NextUnit();
+        break;
+      case kLogUniform:
+        size = exp(log(a) + (log(b) - log(a)) * random.NextUnit());
+        break;
+      case kLogNormal: {
+        // box-muller transform of two uniform values.
+        double u = 1 - random.NextUnit();
+        double v = random.NextUnit();
+        size = a * exp(b * sqrt(-2 * log(u)) * cos(2 * M_PI * v));
+        break;
+      }
+    }
+    return std::max<double>(1, size);
+  }
+};
+
+// CorpusSettings describe the files to generate.
+struct CorpusSettings {
+  std::filesystem::path directory;
+  size_t number_of_files = 100;
+  SizeDistribution sizes;
+  std::vector<const SampleFormat*> formats;
+  std::vector<WavLayout> layouts;
+  std::vector<std::string> layout_names;
+  std::vector<unsigned int> channels = {1, 2};
+  std::vector<unsigned int> sample_rates = {44100, 48000};
+  // files are spread over a tree of this depth, where every directory has
+  // fanout subdirectories. 0 puts all files in directory.
+  unsigned int depth = 0;
+  unsigned int fanout = 4;
+  std::string prefix = "clip";
+  uint64_t seed = 1;
+};
+
+// @desc - splits a comma separated list.
+static std::vector<std::string> SplitList(const char* list) {
+  std::vector<std::string> items;
+  std::string item;
+  for (const char* c = list; ; ++c) {
+    if (*c == ',' || *c == '\0') {
+      if (!item.empty()) {
+        items.push_back(item);
+      }
+      item.clear();
+      if (*c == '\0') {
+        break;
+      }
+    } else {
+      item += *c;
+    }
+  }
+  return items;
+}
+
+// @desc - parses a size with an optional k, M or G suffix, powers of 1024.
+// @return double - the size, negative on error.
+static double ParseSize(const std::string& text) {
+  char* end = nullptr;
+  double size = strtod(text.c_str(), &end);
+  if (end == text.c_str() || size < 0) {
+    return -1;
+  }
+  std::string suffix = end;
+  if (suffix == "k" || suffix == "K") {
+    size *= 1024;
+  } else if (suffix == "M") {
+    size *= 1024 * 1024;
+  } else if (suffix == "G") {
+    size *= 1024 * 1024 * 1024;
+  } else if (!suffix.empty()) {
+    return -1;
+  }
+  return size;
+}
+
+// @desc - parses a size distribution, "fixed:SIZE", "uniform:MIN:MAX",
+//         "loguniform:MIN:MAX" or "lognormal:MEDIAN:SIGMA".
+// @return bool - false on error.
+static bool ParseSizeDistribution(const char* text,
+                                  SizeDistribution& distribution) {
+  std::vector<std::string> parts;
+  std::string part;
+  for (const char* c = text; ; ++c) {
+    if (*c == ':' || *c == '\0') {
+      parts.push_back(part);
+      part.clear();
+      if (*c == '\0') {
+        break;
+      }
+    } else {
+      part += *c;
+    }
+  }
+
+  if (parts.size() == 2 && parts[0] == "fixed") {
+    distribution.kind = SizeDistribution::kFixed;
+    distribution.a = ParseSize(parts[1]);
+    return distribution.a > 0;
+  }
+  if (parts.size() != 3) {
+    return false;
+  }
+  distribution.a = ParseSize(parts[1]);
+  if (parts[0] == "lognormal") {
+    distribution.kind = SizeDistribution::kLogNormal;
+    char* end = nullptr;
+    distribution.b = strtod(parts[2].c_str(), &end);
+    return distribution.a > 0 && *end == '\0' && distribution.b >= 0;
+  }
+  distribution.b = ParseSize(parts[2]);
+  if (parts[0] == "uniform") {
+    distribution.kind = SizeDistribution::kUniform;
+  } else if (parts[0] == "loguniform") {
+    distribution.kind = SizeDistribution::kLogUniform;
+  } else {
+    return false;
+  }
+  return distribution.a > 0 && distribution.b >= distribution.a;
+}
+
+// @desc - picks an item of a list.
+template<typename T>
+const T& Pick(const std::vector<T>& items, Random& random) {
+  return items[random.Next() % items.size()];
+}
+
+// @desc - writes one synthetic wav file, the samples are generated and
+//         written in pieces, so files of any size fit in memory.
+// @return bool - false if the file cannot be written.
+static bool WriteWav(const std::filesystem::path& path,
+                     const SampleFormat& format, WavLayout layout,
+                     unsigned int number_of_channels, unsigned int sample_rate,
+                     uint64_t number_of_frames, Random& random) {
+  auto block_align = (format.bits + 7) / 8 * number_of_channels;
+  auto data_size = number_of_frames * block_align;
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  auto header = MakeWavHeader(format, layout, number_of_channels, sample_rate,
+                              data_size);
+  file.write((const char*)header.data(), header.size());
+  for (uint64_t frame = 0; frame < number_of_frames;
+       frame += kFramesPerWrite) {
+    auto frames = std::min<uint64_t>(kFramesPerWrite,
+                                     number_of_frames - frame);
+    auto data = EncodeSamples(format, GenerateSignal(frame, frames,
+                                                     number_of_channels,
+                                                     sample_rate, random));
+    file.write((const char*)data.data(), data.size());
+  }
+  auto trailer = MakeWavTrailer(layout, data_size);
+  file.write((const char*)trailer.data(), trailer.size());
+  return (bool)file;
+}
+
+// @desc - generates the corpus.
+// @return int - exit code.
+static int MakeCorpus(const CorpusSettings& settings) {
+  // all directories of the tree, the root first.
+  std::vector<std::filesystem::path> directories = {settings.directory};
+  for (size_t i = 0, level_begin = 0; i < settings.depth; ++i) {
+    auto level_end = directories.size();
+    for (auto parent = level_begin; parent < level_end; ++parent) {
+      for (unsigned int child = 0; child < settings.fanout; ++child) {
+        directories.push_back(directories[parent] /
+                              ("d" + std::to_string(child)));
+      }
+    }
+    level_begin = level_end;
+  }
+  for (auto& directory : directories) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+      printf("[ERROR] %s: %s\n", directory.c_str(), error.message().c_str());
+      return 1;
+    }
+  }
+
+  Random random(settings.seed);
+  uint64_t total_size = 0;
+  for (size_t i = 0; i < settings.number_of_files; ++i) {
+    auto& format = *Pick(settings.formats, random);
+    auto layout_index = random.Next() % settings.layouts.size();
+    auto number_of_channels = Pick(settings.channels, random);
+    auto sample_rate = Pick(settings.sample_rates, random);
+    auto& directory = Pick(directories, random);
+    auto block_align = (format.bits + 7) / 8 * number_of_channels;
+    auto data_size = std::min(settings.sizes.Draw(random), kMaxDataSize);
+    auto number_of_frames = std::max<uint64_t>(1, data_size / block_align);
+
+    auto path = directory / (settings.prefix + "-" + std::to_string(i) + "-" +
+                             format.name + "-" +
+                             settings.layout_names[layout_index] + ".wav");
+    if (!WriteWav(path, format, settings.layouts[layout_index],
+                  number_of_channels, sample_rate, number_of_frames,
+                  random)) {
+      printf("[ERROR] %s: cannot write file.\n", path.c_str());
+      return 1;
+    }
+    total_size += number_of_frames * block_align;
+  }
+  printf("%zu files, %.1f MB of samples in %zu directories.\n",
+         settings.number_of_files, total_size / 1e6, directories.size());
+  return 0;
+}
+
+void PrintUsage() {
+  printf("USAGE: washmywaves_corpus [options] output_directory\n");
+  printf("  options:\n");
+  printf("    -n, --files N  number of files, 100 by default.\n");
+  printf("    -s, --size DIST  size of the samples of each file:\n");
+  printf("                  fixed:SIZE, uniform:MIN:MAX, loguniform:MIN:MAX\n");
+  printf("                  or lognormal:MEDIAN:SIGMA. sizes take k, M and\n");
+  printf("                  G suffixes. loguniform:64k:16M by default.\n");
+  printf("    -f, --formats LIST  comma separated formats, all by default:\n");
+  printf("                  ");
+  for (size_t i = 0; i < kNumberOfSampleFormats; ++i) {
+    printf("%s%s", kSampleFormats[i].name,
+           i + 1 < kNumberOfSampleFormats ? "," : ".\n");
+  }
+  printf("    -l, --layouts LIST  chunk layouts, all by default:\n");
+  printf("                  plain,extensible,chunks,odd,rf64.\n");
+  printf("    -c, --channels LIST  numbers of channels, 1,2 by default, up\n");
+  printf("                  to 32. extensible files name the usual speakers\n");
+  printf("                  of up to 8 channels.\n");
+  printf("    -r, --rates LIST  sample rates, 44100,48000 by default.\n");
+  printf("    -d, --depth N  spread files over a directory tree N levels\n");
+  printf("                  deep, 0 by default.\n");
+  printf("    --fanout N  subdirectories of each directory, 4 by default.\n");
+  printf("    --prefix NAME  prefix of file names, clip by default.\n");
+  printf("    --seed N  seed of the generator, 1 by default.\n");
+  printf("  the same options and seed always generate the same files.\n");
+}
+
+// @desc - parses a comma separated list of positive numbers.
+// @return bool - false on error.
+static bool ParseNumbers(const char* list, std::vector<unsigned int>& numbers) {
+  numbers.clear();
+  for (auto& item : SplitList(list)) {
+    char* end = nullptr;
+    auto value = strtol(item.c_str(), &end, 10);
+    if (*end != '\0' || value <= 0) {
+      return false;
+    }
+    numbers.push_back(value);
+  }
+  return !numbers.empty();
+}
+
+int main(int argc, char* argv[]) {
+  CorpusSettings settings;
+  const char* formats = nullptr;
+  const char* layouts = "plain,extensible,chunks,odd,rf64";
+
+  const struct option long_options[] = {
+    {"files", required_argument, nullptr, 'n'},
+    {"size", required_argument, nullptr, 's'},
+    {"formats", required_argument, nullptr, 'f'},
+    {"layouts", required_argument, nullptr, 'l'},
+    {"channels", required_argument, nullptr, 'c'},
+    {"rates", required_argument, nullptr, 'r'},
+    {"depth", required_argument, nullptr, 'd'},
+    {"fanout", required_argument, nullptr, 'F'},
+    {"prefix", required_argument, nullptr, 'p'},
+    {"seed", required_argument, nullptr, 'S'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0},
+  };
+  int option;
+  while ((option = getopt_long(argc, argv, "n:s:f:l:c:r:d:h", long_options,
+                               nullptr)) != -1) {
+    switch (option) {
+      case 'n':
+      case 'd':
+      case 'F':
+      case 'S': {
+        char* end = nullptr;
+        auto value = strtoull(optarg, &end, 10);
+        if (*end != '\0' || (option == 'F' && value == 0)) {
+          printf("invalid number: %s\n", optarg);
+          return 1;
+        }
+        if (option == 'n') {
+          settings.number_of_files = value;
+        } else if (option == 'd') {
+          settings.depth = value;
+        } else if (option == 'F') {
+          settings.fanout = value;
+        } else {
+          settings.seed = value;
+        }
+        break;
+      }
+      case 's':
+        if (!ParseSizeDistribution(optarg, settings.sizes)) {
+          printf("invalid size distribution: %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'f':
+        formats = optarg;
+        break;
+      case 'l':
+        layouts = optarg;
+        break;
+      case 'c':
+        if (!ParseNumbers(optarg, settings.channels) ||
+            *std::max_element(settings.channels.begin(),
+                              settings.channels.end()) >
+                kMaxDownmixChannels) {
+          printf("invalid numbers of channels: %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'r':
+        if (!ParseNumbers(optarg, settings.sample_rates)) {
+          printf("invalid sample rates: %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'p':
+        settings.prefix = optarg;
+        break;
+      case 'h':
+        PrintUsage();
+        return 0;
+      default:
+        PrintUsage();
+        return 1;
+    }
+  }
+  if (argc - optind != 1) {
+    PrintUsage();
+    return 1;
+  }
+  settings.directory = argv[optind];
+
+  if (formats) {
+    for (auto& name : SplitList(formats)) {
+      auto format = FindSampleFormat(name.c_str());
+      if (!format) {
+        printf("unknown format: %s\n", name.c_str());
+        return 1;
+      }
+      settings.formats.push_back(format);
+    }
+  } else {
+    for (size_t i = 0; i < kNumberOfSampleFormats; ++i) {
+      settings.formats.push_back(&kSampleFormats[i]);
+    }
+  }
+  for (auto& name : SplitList(layouts)) {
+    WavLayout layout;
+    if (!FindWavLayout(name.c_str(), layout)) {
+      printf("unknown layout: %s\n", name.c_str());
+      return 1;
+    }
+    settings.layouts.push_back(layout);
+    settings.layout_names.push_back(name);
+  }
+  if (settings.formats.empty() || settings.layouts.empty()) {
+    PrintUsage();
+    return 1;
+  }
+
+  return MakeCorpus(settings);
+}
@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+#include "wav/header.hh"
+
+#include "wav_synth.hh"
+
+const SampleFormat kSampleFormats[] = {
+  {"uint8", WAVE_FORMAT_PCM, 8},
+  {"int12", WAVE_FORMAT_PCM, 12},
+  {"int16", WAVE_FORMAT_PCM, 16},
+  {"int20", WAVE_FORMAT_PCM, 20},
+  {"int24", WAVE_FORMAT_PCM, 24},
+  {"int32", WAVE_FORMAT_PCM, 32},
+  {"float32", WAVE_FORMAT_IEEE_FLOAT, 32},
+  {"float64", WAVE_FORMAT_IEEE_FLOAT, 64},
+  {"alaw", WAVE_FORMAT_ALAW, 8},
+  {"mulaw", WAVE_FORMAT_MULAW, 8},
+};
+
+const size_t kNumberOfSampleFormats =
+    sizeof(kSampleFormats) / sizeof(kSampleFormats[0]);
+
+// speaker positions of extensible files of 1 to 8 channels, indexed by
+// [channels - 1]: mono, stereo, 3.0, quad, 5.0, 5.1, 6.1 and 7.1. files with
+// more channels leave them unnamed.
+const uint32_t kChannelMasks[] = {
+  0x4, 0x3, 0x7, 0x33, 0x37, 0x3f, 0x13f, 0x63f,
+};
+
+// size of the fmt chunk of WAVE_FORMAT_EXTENSIBLE, without its header.
+const uint32_t kExtensibleFmtSize = 40;
+
+// size of the LIST chunk of WavLayout::kExtraChunks, without its header. it
+// is odd, so it is followed by a pad byte.
+const uint32_t kListSize = 255;
+
+// size of the JUNK chunk of WavLayout::kExtraChunks, without its header.
+const uint32_t kJunkSize = 1024;
+
+// size of the chunk of WavLayout::kOddChunk, without its header.
+const uint32_t kOddChunkSize = 7;
+
+const SampleFormat* FindSampleFormat(const char* name) {
+  for (size_t i = 0; i < kNumberOfSampleFormats; ++i) {
+    if (std::strcmp(kSampleFormats[i].name, name) == 0) {
+      return &kSampleFormats[i];
+    }
+  }
+  return nullptr;
+}
+
+bool FindWavLayout(const char* name, WavLayout& layout) {
+  static const struct {
+    const char* name;
+    WavLayout layout;
+  } kLayouts[] = {
+    {"plain", WavLayout::kPlain},
+    {"extensible", WavLayout::kExtensible},
+    {"chunks", WavLayout::kExtraChunks},
+    {"odd", WavLayout::kOddChunk},
+    {"rf64", WavLayout::kRF64},
+  };
+  for (auto& entry : kLayouts) {
+    if (std::strcmp(entry.name, name) == 0) {
+      layout = entry.layout;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint32_t Random::Next() {
+  state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+  return state_ >> 32;
+}
+
+double Random::NextUnit() {
+  return Next() / 4294967296.0;
+}
+
+std::vector<double> GenerateSignal(size_t first_frame, size_t number_of_frames,
+                                   unsigned int number_of_channels,
+                                   unsigned int sample_rate, Random& random) {
+  std::vector<double> signal(number_of_frames * number_of_channels);
+  for (size_t i = 0; i < number_of_frames; ++i) {
+    double t = (double)(first_frame + i) / sample_rate;
+    for (unsigned int channel = 0; channel < number_of_channels; ++channel) {
+      // the sweep restarts every 8 seconds, so long files stay in the audible
+      // range.
+      double frequency = 220 * (channel % 4 + 1) * (1 + fmod(t, 8) / 4);
+      signal[i * number_of_channels + channel] =
+          0.5 * sin(2 * M_PI * frequency * t) +
+          0.3 * sin(2 * M_PI * 3.1 * frequency * t) +
+          0.02 * (random.NextUnit() - 0.5);
+    }
+  }
+  return signal;
+}
+
+// @desc - returns the index of the first segment end that is not below a
+//         value, or 8 if the value is above all of them.
+static unsigned int FindG711Segment(int value, const int (&segment_ends)[8]) {
+  unsigned int segment = 0;
+  while (segment < 8 && value > segment_ends[segment]) {
+    segment++;
+  }
+  return segment;
+}
+
+// @desc - encodes a 16-bits sample to G.711 a-law, like the reference
+//         encoder of ITU-T G.191 does.
+static uint8_t EncodeAlaw(int value) {
+  static const int kSegmentEnds[8] = {0x1f, 0x3f, 0x7f, 0xff, 0x1ff, 0x3ff,
+                                      0x7ff, 0xfff};
+  value >>= 3;
+  uint8_t mask = 0xd5;
+  if (value < 0) {
+    mask = 0x55;
+    value = -value - 1;
+  }
+  auto segment = FindG711Segment(value, kSegmentEnds);
+  if (segment >= 8) {
+    return 0x7f ^ mask;
+  }
+  uint8_t code = segment << 4;
+  code |= (value >> (segment < 2 ? 1 : segment)) & 0x0f;
+  return code ^ mask;
+}
+
+// @desc - encodes a 16-bits sample to G.711 mu-law.
+static uint8_t EncodeMulaw(int value) {
+  static const int kSegmentEnds[8] = {0x3f, 0x7f, 0xff, 0x1ff, 0x3ff, 0x7ff,
+                                      0xfff, 0x1fff};
+  const int kClip = 8159;
+  value >>= 2;
+  uint8_t mask = 0xff;
+  if (value < 0) {
+    mask = 0x7f;
+    value = -value;
+  }
+  value = std::min(value, kClip) + (0x84 >> 2);
+  auto segment = FindG711Segment(value, kSegmentEnds);
+  if (segment >= 8) {
+    return 0x7f ^ mask;
+  }
+  uint8_t code = (segment << 4) | ((value >> (segment + 1)) & 0x0f);
+  return code ^ mask;
+}
+
+std::vector<uint8_t> EncodeSamples(const SampleFormat& format,
+                                   const std::vector<double>& signal) {
+  auto container = (format.bits + 7) / 8;
+  std::vector<uint8_t> data(signal.size() * container);
+  for (size_t i = 0; i < signal.size(); ++i) {
+    auto out = &data[i * container];
+    if (format.audio_format == WAVE_FORMAT_IEEE_FLOAT) {
+      if (format.bits == 32) {
+        float value = signal[i];
+        std::memcpy(out, &value, sizeof(value));
+      } else {
+        std::memcpy(out, &signal[i], sizeof(double));
+      }
+      continue;
+    }
+    if (format.audio_format == WAVE_FORMAT_ALAW ||
+        format.audio_format == WAVE_FORMAT_MULAW) {
+      int value = lround(signal[i] * 32767);
+      out[0] = format.audio_format == WAVE_FORMAT_ALAW ? EncodeAlaw(value) :
+                                                         EncodeMulaw(value);
+      continue;
+    }
+
+    auto max = (int64_t(1) << (format.bits - 1)) - 1;
+    uint64_t value = llround(signal[i] * max);
+    if (format.bits == 8) {
+      // 8-bits samples are unsigned.
+      value += 128;
+    }
+    // samples are left-justified in their container.
+    value <<= container * 8 - format.bits;
+    for (unsigned int byte = 0; byte < container; ++byte) {
+      out[byte] = value >> (byte * 8);
+    }
+  }
+  return data;
+}
+
+static void AppendUint16(std::vector<uint8_t>& buffer, uint16_t value) {
+  buffer.push_back(value);
+  buffer.push_back(value >> 8);
+}
+
+static void AppendUint32(std::vector<uint8_t>& buffer, uint32_t value) {
+  AppendUint16(buffer, value);
+  AppendUint16(buffer, value >> 16);
+}
+
+static void AppendUint64(std::vector<uint8_t>& buffer, uint64_t value) {
+  AppendUint32(buffer, value);
+  AppendUint32(buffer, value >> 32);
+}
+
+static void AppendChunk(std::vector<uint8_t>& buffer, const char* id,
+                        uint32_t size) {
+  buffer.insert(buffer.end(), id, id + 4);
+  AppendUint32(buffer, size);
+}
+
+// @desc - appends an empty chunk and its pad byte.
+static void AppendEmptyChunk(std::vector<uint8_t>& buffer, const char* id,
+                             uint32_t size) {
+  AppendChunk(buffer, id, size);
+  buffer.resize(buffer.size() + size + (size & 1));
+}
+
+std::vector<uint8_t> MakeWavHeader(const SampleFormat& format,
+                                   WavLayout layout,
+                                   unsigned int number_of_channels,
+                                   unsigned int sample_rate,
+                                   uint64_t data_size) {
+  auto container = (format.bits + 7) / 8;
+  auto block_align = container * number_of_channels;
+  std::vector<uint8_t> wav;
+  bool rf64 = layout == WavLayout::kRF64;
+  AppendChunk(wav, rf64 ? "RF64" : "RIFF", 0);
+  wav.insert(wav.end(), {'W', 'A', 'V', 'E'});
+  if (rf64) {
+    // riff size is filled in below, the table of other chunks is empty.
+    AppendChunk(wav, "ds64", 28);
+    AppendUint64(wav, 0);
+    AppendUint64(wav, data_size);
+    AppendUint64(wav, data_size / block_align);
+    AppendUint32(wav, 0);
+  }
+  if (layout == WavLayout::kExtensible) {
+    AppendChunk(wav, "fmt ", kExtensibleFmtSize);
+    AppendUint16(wav, WAVE_FORMAT_EXTENSIBLE);
+  } else {
+    AppendChunk(wav, "fmt ", 16);
+    AppendUint16(wav, format.audio_format);
+  }
+  AppendUint16(wav, number_of_channels);
+  AppendUint32(wav, sample_rate);
+  AppendUint32(wav, sample_rate * block_align);
+  AppendUint16(wav, block_align);
+  if (layout == WavLayout::kExtensible) {
+    // extensible files state the container width and the valid bits apart.
+    AppendUint16(wav, container * 8);
+    AppendUint16(wav, 22);
+    AppendUint16(wav, format.bits);
+    AppendUint32(wav, number_of_channels <= std::size(kChannelMasks) ?
+                          kChannelMasks[number_of_channels - 1] : 0);
+    // KSDATAFORMAT_SUBTYPE_PCM or _IEEE_FLOAT, the format code followed by
+    // the fixed part of the guid.
+    AppendUint16(wav, format.audio_format);
+    const uint8_t kGuidTail[] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+    wav.insert(wav.end(), std::begin(kGuidTail), std::end(kGuidTail));
+  } else {
+    AppendUint16(wav, format.bits);
+  }
+
+  if (layout == WavLayout::kExtraChunks) {
+    AppendChunk(wav, "fact", 4);
+    AppendUint32(wav, data_size / block_align);
+    AppendEmptyChunk(wav, "LIST", kListSize);
+  } else if (layout == WavLayout::kOddChunk) {
+    AppendEmptyChunk(wav, "odd ", kOddChunkSize);
+  }
+  AppendChunk(wav, "data", rf64 ? 0xFFFFFFFF : data_size);
+
+  uint64_t riff_size = wav.size() - 8 + data_size +
+                       MakeWavTrailer(layout, data_size).size();
+  if (rf64) {
+    std::memcpy(&wav[20], &riff_size, sizeof(riff_size));
+    riff_size = 0xFFFFFFFF;
+  }
+  uint32_t riff_size_32 = riff_size;
+  std::memcpy(&wav[4], &riff_size_32, sizeof(riff_size_32));
+  return wav;
+}
+
+std::vector<uint8_t> MakeWavTrailer(WavLayout layout, uint64_t data_size) {
+  std::vector<uint8_t> wav;
+  if (data_size & 1) {
+    wav.push_back(0);
+  }
+  if (layout == WavLayout::kExtraChunks) {
+    AppendEmptyChunk(wav, "JUNK", kJunkSize);
+  }
+  return wav;
+}
+
+std::vector<uint8_t> MakeWav(const SampleFormat& format, WavLayout layout,
+                             unsigned int number_of_channels,
+                             unsigned int sample_rate,
+                             const std::vector<uint8_t>& data) {
+  auto wav = MakeWavHeader(format, layout, number_of_channels, sample_rate,
+                           data.size());
+  wav.insert(wav.end(), data.begin(), data.end());
+  auto trailer = MakeWavTrailer(layout, data.size());
+  wav.insert(wav.end(), trailer.begin(), trailer.end());
+  return wav;
+}
@@ -0,0 +1,118 @@
+#ifndef WASHMYWAVES_TOOLS_WAV_SYNTH_H__
+#define WASHMYWAVES_TOOLS_WAV_SYNTH_H__
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// SampleFormat is a sample format of synthetic wav files.
+struct SampleFormat {
+  const char* name;
+  // WAVE_FORMAT_PCM, WAVE_FORMAT_IEEE_FLOAT, WAVE_FORMAT_ALAW or
+  // WAVE_FORMAT_MULAW.
+  uint16_t audio_format;
+  // bits of each sample, the container is rounded up to whole bytes.
+  unsigned int bits;
+};
+
+// every format WavHeader supports, "uint8", "int12", ..., "float64",
+// "alaw" and "mulaw".
+extern const SampleFormat kSampleFormats[];
+extern const size_t kNumberOfSampleFormats;
+
+// @desc - looks up a format by name.
+// @param name - name of the format.
+// @return const SampleFormat* - nullptr if there is no such format.
+const SampleFormat* FindSampleFormat(const char* name);
+
+// WavLayout selects how the chunks of a synthetic file are laid out, so the
+// parser meets the variants found in the wild.
+enum class WavLayout {
+  // riff header, a 16-bytes fmt chunk and data chunk.
+  kPlain,
+  // fmt chunk of WAVE_FORMAT_EXTENSIBLE, with valid bits, channel mask and
+  // sub format guid.
+  kExtensible,
+  // fact and LIST chunks before data chunk and a JUNK chunk after it.
+  kExtraChunks,
+  // an odd-sized chunk before data chunk, followed by its pad byte.
+  kOddChunk,
+  // RF64 header with the sizes in ds64 chunk and 0xFFFFFFFF in the 32-bit
+  // size fields.
+  kRF64,
+};
+
+// @desc - looks up a layout by name, "plain", "extensible", "chunks", "odd"
+//         or "rf64".
+// @param name - name of the layout.
+// @param layout - receives the layout.
+// @return bool - false if there is no such layout.
+bool FindWavLayout(const char* name, WavLayout& layout);
+
+// Random is a small deterministic generator, so every run produces the same
+// data from the same seed.
+class Random {
+public:
+  explicit Random(uint64_t seed = 0x853c49e6748fea9bULL) : state_(seed) {}
+
+  // @return uint32_t - the next random value.
+  uint32_t Next();
+
+  // @return double - a value in [0, 1).
+  double NextUnit();
+
+private:
+  uint64_t state_;
+};
+
+// @desc - generates a piece of an interleaved test signal, two sweeping
+//         tones and some noise. it is not silence, so lame has to do its
+//         full work. pieces of one signal can be generated one after another.
+// @param first_frame - index of the first frame of the piece.
+// @param number_of_frames - length of the piece.
+// @param number_of_channels - number of channels.
+// @param sample_rate - sample rate of the signal.
+// @param random - source of the noise.
+// @return std::vector<double> - samples in [-1, 1].
+std::vector<double> GenerateSignal(size_t first_frame, size_t number_of_frames,
+                                   unsigned int number_of_channels,
+                                   unsigned int sample_rate, Random& random);
+
+// @desc - stores samples the way data chunk of a format holds them.
+// @param format - the format.
+// @param signal - samples in [-1, 1].
+// @return std::vector<uint8_t> - raw little-endian samples.
+std::vector<uint8_t> EncodeSamples(const SampleFormat& format,
+                                   const std::vector<double>& signal);
+
+// @desc - builds everything of a wav file that comes before the samples.
+// @param format - format of the samples.
+// @param layout - layout of the chunks.
+// @param number_of_channels - number of channels.
+// @param sample_rate - sample rate.
+// @param data_size - size of the samples in bytes.
+// @return std::vector<uint8_t> - the bytes up to the first sample.
+std::vector<uint8_t> MakeWavHeader(const SampleFormat& format,
+                                   WavLayout layout,
+                                   unsigned int number_of_channels,
+                                   unsigned int sample_rate,
+                                   uint64_t data_size);
+
+// @desc - builds everything of a wav file that comes after the samples.
+// @param layout - layout of the chunks, the same as of the header.
+// @param data_size - size of the samples in bytes.
+// @return std::vector<uint8_t> - the bytes after the last sample.
+std::vector<uint8_t> MakeWavTrailer(WavLayout layout, uint64_t data_size);
+
+// @desc - builds a whole wav file in memory.
+// @param format - format of the samples.
+// @param layout - layout of the chunks.
+// @param number_of_channels - number of channels.
+// @param sample_rate - sample rate.
+// @param data - raw samples, as returned by EncodeSamples().
+// @return std::vector<uint8_t> - the file.
+std::vector<uint8_t> MakeWav(const SampleFormat& format, WavLayout layout,
+                             unsigned int number_of_channels,
+                             unsigned int sample_rate,
+                             const std::vector<uint8_t>& data);
+
+#endif // WASHMYWAVES_TOOLS_WAV_SYNTH_H__